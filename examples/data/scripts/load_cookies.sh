@@ -12,17 +12,8 @@ else
 fi
 readonly cookie_file
 
-awk -F \\t '
-BEGIN {
-    scheme["TRUE"] = "https";
-    scheme["FALSE"] = "http";
-}
-$0 ~ /^#HttpOnly_/ {
-    gsub(/@/, "\\@")
-    printf("cookie add \"%s\" \"%s\" \"%s\" \"%s\" \"%s\" \"%s\"\n", substr($1,length("#HttpOnly_")+1,length($1)), $3, $6, $7, scheme[$4], $5)
-}
-$0 !~ /^#/ {
-    gsub(/@/, "\\@")
-    printf("cookie add \"%s\" \"%s\" \"%s\" \"%s\" \"%s\" \"%s\"\n", $1, $3, $6, $7, scheme[$4], $5)
-}
-' "$cookie_file"
+[ -f "$cookie_file" ] || exit 0
+
+# The file is parsed by uzbl itself; just escape the path for the command.
+escaped="$( printf '%s' "$cookie_file" | sed -e 's/[\\"@]/\\&/g' )"
+printf 'cookie load "%s"\n' "$escaped"
@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+'''
+Measure how long splitting event arguments takes, for the argument strings
+of a single cookie event and of a long line of them.
+
+Run from the top of the source tree:
+
+    python3 misc/arguments-bench.py [-n NUMBER]
+'''
+
+import os
+import sys
+import timeit
+from argparse import ArgumentParser
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from uzbl.arguments import Arguments  # noqa: E402
+
+COOKIE = "'example%d.com' '/path/%d' 'session' 'some cookie value %d' 'https' '1700000000'"
+
+LINES = [
+    ('cookie', COOKIE % (0, 0, 0)),
+    ('long cookie', ' '.join([COOKIE % (i, i, i) for i in range(20)])),
+    ('escaped', r"'it\'s' @<js>@ " + ' '.join(['word'] * 10)),
+]
+
+
+def main():
+    parser = ArgumentParser(description=__doc__.split('\n\n')[0].strip())
+    parser.add_argument('-n', '--number', type=int, default=2000,
+                        help='number of times each line is split')
+    args = parser.parse_args()
+
+    print('%-12s %8s %12s' % ('line', 'length', 'us/split'))
+    for name, line in LINES:
+        seconds = min(timeit.repeat(lambda: Arguments(line), number=args.number, repeat=3))
+        print('%-12s %8d %12.1f' % (name, len(line), seconds / args.number * 1e6))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+'''
+Measure how many events per second the event manager daemon dispatches with
+a number of concurrently connected instances.
+
+Each instance is a separate process which floods the daemon with KEY_PRESS and
+SCROLL_VERT events (as fast typing and scrolling would) and then exits. The
+daemon runs with a single global plugin which handles the events by spinning
+for --cost microseconds each, so by default the numbers reflect the socket
+and dispatch overhead rather than the cost of any real plugin. With
+--workers the instances are spread over that many worker processes.
+
+Run from the top of the source tree:
+
+    python3 misc/event-manager-bench.py [-e EVENTS] [-c COST] [-w N] [INSTANCES ...]
+'''
+
+import os
+import sys
+import socket
+import tempfile
+import time
+from argparse import ArgumentParser
+from multiprocessing import Barrier, Process
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from uzbl.daemon import UzblEventDaemon  # noqa: E402
+from uzbl.workers import WorkerPool  # noqa: E402
+
+
+class Counter(object):
+    '''Counts events and stops the daemon once every instance has exited.'''
+
+    instances = 0
+    cost = 0
+
+    def __init__(self, event_manager):
+        self.event_manager = event_manager
+        self.events = 0
+        self.exited = 0
+
+    def new_uzbl(self, uzbl):
+        uzbl.connect('KEY_PRESS', self.count)
+        uzbl.connect('SCROLL_VERT', self.count)
+
+    def free_uzbl(self, uzbl):
+        self.exited += 1
+        if self.exited == self.instances:
+            self.event_manager.loop.call_soon(self.event_manager.quit)
+
+    def count(self, *args):
+        self.events += 1
+        if self.cost:
+            end = time.perf_counter() + self.cost
+            while time.perf_counter() < end:
+                pass
+
+    def cleanup(self):
+        del self.event_manager
+
+
+class BenchPluginDirectory(object):
+    def __init__(self):
+        self.global_plugins = []
+        self.per_instance_plugins = []
+
+    def load(self):
+        self.global_plugins.append(Counter)
+
+
+def client(path, index, events, barrier):
+    name = 'bench-%d' % index
+    flood = [
+        'EVENT [%s] KEY_PRESS \'\' a\n' % name,
+        'EVENT [%s] SCROLL_VERT 120 0 4000 600\n' % name,
+    ]
+    payload = ''.join(
+        ['EVENT [%s] INSTANCE_START %d\n' % (name, os.getpid())] +
+        [flood[i % 2] for i in range(events)] +
+        ['EVENT [%s] INSTANCE_EXIT\n' % name]
+    ).encode('utf-8')
+
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(path)
+    # Every instance is connected before any of them can exit (and so make
+    # an auto closing daemon quit).
+    barrier.wait()
+    sock.sendall(payload)
+    sock.close()
+
+
+def run(instances, events, workers):
+    path = os.path.join(tempfile.mkdtemp(), 'event_daemon')
+    Counter.instances = instances
+
+    if workers:
+        # The counters live in the workers, which quit once the instances
+        # are gone; every event sent has been handled by then.
+        daemon = WorkerPool(BenchPluginDirectory(), {}, path, workers,
+                            auto_close=True)
+    else:
+        daemon = UzblEventDaemon(BenchPluginDirectory(), {}, path)
+        counter = daemon.plugins[Counter]
+    daemon.listen()
+
+    barrier = Barrier(instances)
+    clients = [Process(target=client, args=(path, i, events, barrier))
+               for i in range(instances)]
+
+    start = time.time()
+    for proc in clients:
+        proc.start()
+    daemon.run()
+    elapsed = time.time() - start
+
+    for proc in clients:
+        proc.join()
+    os.rmdir(os.path.dirname(path))
+
+    if workers:
+        return events * instances, elapsed
+    return counter.events, elapsed
+
+
+def main():
+    parser = ArgumentParser(description=__doc__.split('\n\n')[0].strip())
+    parser.add_argument('-e', '--events', type=int, default=200000,
+                        help='total number of events sent by all instances')
+    parser.add_argument('-c', '--cost', type=float, default=0,
+                        help='microseconds of CPU time spent on each event')
+    parser.add_argument('-w', '--workers', type=int, default=0,
+                        help='spread the instances over this many workers')
+    parser.add_argument('instances', type=int, nargs='*',
+                        default=[1, 10, 100])
+    args = parser.parse_args()
+
+    Counter.cost = args.cost / 1e6
+
+    print('%10s %12s %10s %14s' % ('instances', 'events', 'seconds', 'events/sec'))
+    for instances in args.instances:
+        total, elapsed = run(instances, args.events // instances, args.workers)
+        print('%10d %12d %10.3f %14.0f' % (instances, total, elapsed, total / elapsed))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,313 @@
+#!/usr/bin/env python3
+'''
+Record the messages uzbl instances send to the event manager and replay them
+into an event manager daemon, to see how much its plugins cost.
+
+`record` listens on a socket of its own and passes every connection on to the
+real event manager, writing each message to the output file with the time it
+was sent. Point uzbl at the tap socket instead of the event manager's.
+
+`replay` feeds recorded messages to a UzblEventDaemon running the chosen
+plugins, as fast as possible or at a multiple of the recorded speed. Besides
+recordings it reads the log of an event manager run with print_events
+(`uzbl-event-manager -vvv`), which only holds the events, and bare message
+lines, which carry no times. It reports the CPU time spent handling each type
+of event, the dispatch latency (the time from when a message was due until it
+was handled) and how much the process grew after each pass over the input.
+
+Cookies are kept in memory unless a config file says otherwise, so replaying
+does not touch the cookie jar.
+
+Run from the top of the source tree:
+
+    python3 misc/event-manager-replay.py record -t TAP -f SOCKET -o FILE
+    python3 misc/event-manager-replay.py replay [-s SPEED] [-l LOOPS]
+                                                [-p PLUGIN,..] [-c CONFIG] FILE ..
+'''
+
+import ast
+import asyncio
+import configparser
+import gc
+import logging
+import os
+import re
+import resource
+import signal
+import sys
+import time
+from argparse import ArgumentParser
+from collections import defaultdict
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from uzbl.daemon import PluginDirectory, UzblEventDaemon  # noqa: E402
+
+# <time> <message>, as written by record.
+RECORDED = re.compile(r'^(\d+(?:\.\d*)?) ((?:EVENT|REQUEST-\S*) .*)$')
+# Top level events in a print_events log, with the time of the log file.
+LOGGED = re.compile(r'^(?:\[(\d+(?:\.\d*)?)\] )?uzbl-instance(\[[^ ]*\]): DEBUG: '
+                    r'--> (\S+)(?: (\(.*\)))?(?: \{.*\})?$')
+
+
+def read_messages(paths):
+    '''Return the (time or None, instance name, message) of every message
+    in the files, in order.'''
+
+    messages = []
+    for path in paths:
+        with open(path, encoding='utf-8', errors='replace') as f:
+            for line in f:
+                line = line.rstrip('\n')
+                stamp = None
+                match = RECORDED.match(line)
+                if match:
+                    stamp, msg = float(match.group(1)), match.group(2)
+                elif line.startswith('EVENT ') or line.startswith('REQUEST-'):
+                    msg = line
+                else:
+                    match = LOGGED.match(line)
+                    if not match:
+                        continue
+                    stamp, name, event, args = match.groups()
+                    stamp = float(stamp) if stamp else None
+                    args = ' '.join(ast.literal_eval(args)) if args else ''
+                    msg = 'EVENT %s %s %s' % (name, event, args)
+
+                parts = msg.split(' ', 3)
+                if len(parts) < 3:
+                    continue
+                messages.append((stamp, parts[1], msg))
+    return messages
+
+
+def message_kind(msg):
+    kind, name, what = msg.split(' ', 3)[:3]
+    if kind == 'EVENT':
+        return what.upper()
+    return 'REQUEST %s' % what.upper()
+
+
+class Proto(object):
+    '''Stands in for the connection of an instance and drops its replies.'''
+
+    def __init__(self):
+        self.socket = object()
+
+    def push(self, data):
+        pass
+
+    def close(self):
+        pass
+
+
+class ChosenPlugins(PluginDirectory):
+    '''Loads the plugins as usual and keeps those in the named modules.'''
+
+    def __init__(self, names):
+        super(ChosenPlugins, self).__init__()
+        self.names = names
+
+    def load(self):
+        super(ChosenPlugins, self).load()
+        if not self.names:
+            return
+
+        def chosen(plugin):
+            return plugin.__module__.rsplit('.', 1)[-1] in self.names
+
+        self.global_plugins = list(filter(chosen, self.global_plugins))
+        self.per_instance_plugins = list(filter(chosen, self.per_instance_plugins))
+
+
+class Stats(object):
+    def __init__(self):
+        self.cpu = defaultdict(float)
+        self.latency = defaultdict(list)
+        self.errors = 0
+
+    def add(self, kind, cpu, latency):
+        self.cpu[kind] += cpu
+        self.latency[kind].append(latency)
+
+    def report(self):
+        def percentile(times, p):
+            return times[min(len(times) - 1, int(len(times) * p))] * 1e6
+
+        def row(kind, cpu, times):
+            times.sort()
+            print('%-24s %8d %10.1f %10.1f %10.1f %10.1f' % (
+                kind[:24], len(times), cpu * 1e3, cpu / len(times) * 1e6,
+                percentile(times, 0.5), percentile(times, 0.99)))
+
+        print('%-24s %8s %10s %10s %10s %10s' % (
+            'message', 'count', 'cpu ms', 'cpu us', 'p50 us', 'p99 us'))
+        for kind in sorted(self.cpu, key=self.cpu.get, reverse=True):
+            row(kind, self.cpu[kind], self.latency[kind])
+        row('all', sum(self.cpu.values()),
+            [t for times in self.latency.values() for t in times])
+        if self.errors:
+            print('%d messages raised errors' % self.errors)
+
+
+def rss():
+    '''The resident set size of the process in bytes.'''
+    try:
+        with open('/proc/self/statm') as f:
+            return int(f.read().split()[1]) * resource.getpagesize()
+    except OSError:
+        return resource.getrusage(resource.RUSAGE_SELF).ru_maxrss * 1024
+
+
+def replay(daemon, messages, speed, stats):
+    '''Pass the messages to the instances they came from, creating an
+    instance for every name not yet (or no longer) connected.'''
+
+    instances = {}
+    clock, cpu = time.perf_counter, time.process_time
+    start = clock()
+    first = None
+
+    for (stamp, name, msg) in messages:
+        due = None
+        if speed and stamp is not None:
+            if first is None:
+                first = stamp
+            due = start + (stamp - first) / speed
+            delay = due - clock()
+            if delay > 0:
+                time.sleep(delay)
+
+        proto = instances.get(name)
+        if proto is None or proto.socket not in daemon.uzbls:
+            proto = instances[name] = Proto()
+            daemon.add_instance(proto)
+        uzbl = daemon.uzbls[proto.socket]
+
+        began, used = clock(), cpu()
+        try:
+            uzbl.parse_msg(msg)
+        except Exception:
+            stats.errors += 1
+        used, done = cpu() - used, clock()
+        stats.add(message_kind(msg), used, done - (began if due is None else due))
+
+    # Leave no instance behind for the next pass.
+    for proto in instances.values():
+        if proto.socket in daemon.uzbls:
+            daemon.uzbls[proto.socket].close()
+
+
+def replay_action(args):
+    messages = read_messages(args.files)
+    if not messages:
+        print('no messages found', file=sys.stderr)
+        return 1
+
+    config = configparser.ConfigParser()
+    config.read_dict({'cookies': {'global.type': 'memory',
+                                  'session.type': 'memory'}})
+    if args.config:
+        config.read(args.config)
+
+    plugins = [p for p in args.plugins.split(',') if p] if args.plugins else []
+    daemon = UzblEventDaemon(ChosenPlugins(plugins), config, None)
+    stats = Stats()
+
+    gc.collect()
+    before = last = rss()
+    for i in range(args.loops):
+        replay(daemon, messages, args.speed, stats)
+        gc.collect()
+        now = rss()
+        print('pass %d: %d messages, rss %.1f MiB (%+.1f MiB)' % (
+            i + 1, len(messages), now / 2**20, (now - last) / 2**20))
+        last = now
+    print('grew %+.1f MiB over %d passes' % ((last - before) / 2**20, args.loops))
+    print()
+
+    stats.report()
+    return 0
+
+
+async def tap(reader, writer, forward, out):
+    upstream_reader, upstream_writer = await asyncio.open_unix_connection(forward)
+
+    async def to_event_manager():
+        while True:
+            line = await reader.readline()
+            if not line:
+                break
+            upstream_writer.write(line)
+            out.write('%f %s' % (time.time(), line.decode('utf-8', 'replace')))
+
+        upstream_writer.close()
+
+    async def to_uzbl():
+        while True:
+            data = await upstream_reader.read(1 << 16)
+            if not data:
+                break
+            writer.write(data)
+        writer.close()
+
+    await asyncio.gather(to_event_manager(), to_uzbl())
+    out.flush()
+
+
+def record_action(args):
+    loop = asyncio.new_event_loop()
+    out = open(args.output, 'a', encoding='utf-8')
+
+    async def serve():
+        return await asyncio.start_unix_server(
+            lambda r, w: tap(r, w, args.forward, out), args.tap, limit=1 << 20)
+
+    server = loop.run_until_complete(serve())
+    for sig in (signal.SIGINT, signal.SIGTERM):
+        loop.add_signal_handler(sig, loop.stop)
+
+    print('recording %s to %s, ^C to stop' % (args.tap, args.output))
+    try:
+        loop.run_forever()
+    finally:
+        server.close()
+        out.close()
+        os.unlink(args.tap)
+        loop.close()
+    return 0
+
+
+def main():
+    parser = ArgumentParser(description=__doc__.split('\n\n')[0].strip())
+    actions = parser.add_subparsers(dest='action', required=True)
+
+    record = actions.add_parser('record', help='record messages through a tap socket')
+    record.add_argument('-t', '--tap', required=True,
+                        help='socket for uzbl to connect to')
+    record.add_argument('-f', '--forward', required=True,
+                        help='socket of the event manager')
+    record.add_argument('-o', '--output', required=True,
+                        help='file the messages are appended to')
+
+    replay = actions.add_parser('replay', help='replay messages into the plugins')
+    replay.add_argument('-s', '--speed', type=float, default=0,
+                        help='multiple of the recorded speed, 0 for as fast as possible')
+    replay.add_argument('-l', '--loops', type=int, default=1,
+                        help='number of passes over the messages')
+    replay.add_argument('-p', '--plugins',
+                        help='comma separated plugin modules to load, defaults to all')
+    replay.add_argument('-c', '--config',
+                        help='event manager configuration file')
+    replay.add_argument('files', nargs='+')
+
+    args = parser.parse_args()
+    logging.basicConfig(level=logging.ERROR,
+                        format='%(name)s: %(levelname)s: %(message)s')
+    if args.action == 'record':
+        return record_action(args)
+    return replay_action(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+'''
+Measure how long the event manager takes from a KEY_PRESS event to the
+status bar update it sends back, with the built-in plugins and the binds of
+the example config loaded.
+
+Every keystroke is a KEY_PRESS and KEY_RELEASE pair fed straight to the
+instance, so the numbers leave out the socket. The keys walk through a
+stacked bind, a few unbound characters and <Escape>.
+
+Run from the top of the source tree:
+
+    python3 misc/keystroke-bench.py [-n NUMBER]
+'''
+
+import configparser
+import os
+import sys
+import time
+from argparse import ArgumentParser
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..'))
+
+from uzbl.core import Uzbl  # noqa: E402
+from uzbl.daemon import PluginDirectory, UzblEventDaemon  # noqa: E402
+
+CONFIG = os.path.join(os.path.dirname(__file__), '..', 'examples', 'config', 'config')
+
+# The events behind the config aliases which set up the event manager.
+ALIASES = {
+    '@modmap': 'MODMAP',
+    '@ignore_key': 'IGNORE_KEY',
+    '@on_event': 'ON_EVENT',
+    '@on_set': 'ON_SET',
+    '@mode_config': 'MODE_CONFIG',
+    '@bind': 'MODE_BIND global',
+    '@cbind': 'MODE_BIND command',
+    '@ibind': 'MODE_BIND insert',
+    '@ebind': 'MODE_BIND global,-insert',
+}
+
+KEYS = ['g', 'x', 'Escape', 'x', 'y', 'z', 'Escape']
+
+
+class Proto(object):
+    socket = None
+
+    def push(self, data):
+        pass
+
+
+def setup():
+    daemon = UzblEventDaemon(PluginDirectory(), configparser.ConfigParser(), None)
+    uzbl = Uzbl(daemon, Proto())
+    uzbl.parse_msg('EVENT [bench] INSTANCE_START %d' % os.getpid())
+
+    with open(CONFIG) as config:
+        for line in config:
+            words = line.split(None, 1)
+            if len(words) == 2 and words[0] in ALIASES:
+                uzbl.parse_msg('EVENT [bench] %s %s' % (ALIASES[words[0]], words[1].strip()))
+
+    uzbl.parse_msg('EVENT [bench] VARIABLE_SET mode str command')
+    return uzbl
+
+
+def main():
+    parser = ArgumentParser(description=__doc__.split('\n\n')[0].strip())
+    parser.add_argument('-n', '--number', type=int, default=20000,
+                        help='number of keystrokes')
+    args = parser.parse_args()
+
+    uzbl = setup()
+    times = []
+    clock = time.perf_counter
+    for i in range(args.number):
+        key = KEYS[i % len(KEYS)]
+        start = clock()
+        uzbl.parse_msg("EVENT [bench] KEY_PRESS '' %s" % key)
+        uzbl.parse_msg("EVENT [bench] KEY_RELEASE '' %s" % key)
+        times.append(clock() - start)
+
+    times.sort()
+    print('%10s %10s %10s %10s' % ('keys', 'p50 us', 'p99 us', 'max us'))
+    print('%10d %10.1f %10.1f %10.1f' % (
+        len(times), times[len(times) // 2] * 1e6,
+        times[len(times) * 99 // 100] * 1e6, times[-1] * 1e6))
+
+
+if __name__ == '__main__':
+    main()
@@ -8,6 +8,7 @@
       description='Uzbl event daemon',
       url='http://uzbl.org',
       packages=['uzbl', 'uzbl.plugins'],
+      python_requires='>=3.9',
       entry_points={
           'console_scripts': [
              'uzbl-event-manager = uzbl.event_manager:main'
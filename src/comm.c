@@ -25,6 +25,43 @@ uzbl_comm_string_append_double (GString *buf, double val)
     g_string_append (buf, double_buf);
 }
 
+void
+uzbl_comm_string_append_json (GString *buf, const gchar *str)
+{
+    if (!str) {
+        g_string_append (buf, "null");
+        return;
+    }
+
+    g_string_append_c (buf, '"');
+
+    for (const gchar *p = str; *p; ++p) {
+        switch (*p) {
+        case '"':
+            g_string_append (buf, "\\\"");
+            break;
+        case '\\':
+            g_string_append (buf, "\\\\");
+            break;
+        case '\n':
+            g_string_append (buf, "\\n");
+            break;
+        case '\t':
+            g_string_append (buf, "\\t");
+            break;
+        default:
+            if ((guchar)*p < 0x20) {
+                g_string_append_printf (buf, "\\u%04x", (guchar)*p);
+            } else {
+                g_string_append_c (buf, *p);
+            }
+            break;
+        }
+    }
+
+    g_string_append_c (buf, '"');
+}
+
 GString *
 uzbl_comm_vformat (const gchar *directive, const gchar *function, va_list vargs)
 {
@@ -43,6 +80,9 @@ uzbl_comm_vformat (const gchar *directive, const gchar *function, va_list vargs)
         case TYPE_ULL:
             g_string_append_printf (message, "%llu", va_arg (vargs, unsigned long long));
             break;
+        case TYPE_LL:
+            g_string_append_printf (message, "%lld", va_arg (vargs, long long));
+            break;
         case TYPE_STR:
             /* A string that needs to be escaped. */
             g_string_append_c (message, '\'');
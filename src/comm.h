@@ -5,6 +5,8 @@
 
 void
 uzbl_comm_string_append_double (GString *buf, double val);
+void
+uzbl_comm_string_append_json (GString *buf, const gchar *str);
 
 GString *
 uzbl_comm_vformat (const gchar *directive, const gchar *function, va_list vargs);
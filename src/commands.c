@@ -1,5 +1,6 @@
 #include "commands.h"
 
+#include "config-cache.h"
 #include "events.h"
 #include "gui.h"
 #include "io.h"
@@ -9,11 +10,15 @@
 #include "scheme.h"
 #include "setup.h"
 #include "soup.h"
+#include "stats.h"
+#include "timeline.h"
 #include "type.h"
 #include "util.h"
 #include "uzbl-core.h"
 #include "variables.h"
 
+#include <gio/gunixinputstream.h>
+
 #include <ctype.h>
 #include <errno.h>
 #include <stdlib.h>
@@ -36,6 +41,8 @@
 struct _UzblCommands {
     /* Table of all builtin commands. */
     GHashTable *table;
+    /* Statistics of each builtin command, by its index in the table. */
+    UzblStatsEntry **stats;
 
     /* Search variables */
     UzblFindOptions  search_options;
@@ -82,6 +89,8 @@ uzbl_commands_init ()
         ++cmd;
     }
 
+    uzbl.commands->stats = g_new0 (UzblStatsEntry *, cmd - builtin_command_table);
+
     init_js_commands_api ();
 }
 
@@ -89,6 +98,7 @@ void
 uzbl_commands_free ()
 {
     g_hash_table_destroy (uzbl.commands->table);
+    g_free (uzbl.commands->stats);
 
     g_free (uzbl.commands->search_text);
 
@@ -154,53 +164,18 @@ uzbl_commands_args_free (GArray *argv)
     g_array_free (argv, TRUE);
 }
 
-static void
-parse_command_arguments (const gchar *args, GArray *argv, gboolean split);
+static const UzblCommand *
+parse_traced (const gchar *cmd, GArray *argv, UzblExpandTrace *trace);
 
 const UzblCommand *
 uzbl_commands_parse (const gchar *cmd, GArray *argv)
 {
-    if (!cmd || cmd[0] == '#' || !*cmd) {
-        return NULL;
-    }
-
-    gchar *exp_line = uzbl_variables_expand (cmd);
-    if (!exp_line || !*exp_line) {
-        g_free (exp_line);
-        return NULL;
-    }
-
-    /* Separate the line into the command and its parameters. */
-    gchar **tokens = g_strsplit (exp_line, " ", 2);
-
-    const gchar *command = tokens[0];
-    const gchar *arg_string = tokens[1];
-
-    /* Look up the command. */
-    const UzblCommand *info = g_hash_table_lookup (uzbl.commands->table, command);
-
-    if (!info) {
-        uzbl_events_send (COMMAND_ERROR, NULL,
-            TYPE_STR, command,
-            NULL);
-
-        g_free (exp_line);
-        g_strfreev (tokens);
-
-        return NULL;
-    }
-
-    /* Parse the arguments. */
-    if (argv && arg_string) {
-        parse_command_arguments (arg_string, argv, info->split);
-    }
-
-    g_free (exp_line);
-    g_strfreev (tokens);
-
-    return info;
+    return parse_traced (cmd, argv, NULL);
 }
 
+static void
+command_finished (const UzblCommand *info, GArray *argv, gint64 start, GString *result);
+
 void
 uzbl_commands_run_parsed (const UzblCommand *info, GArray *argv, GString *result)
 {
@@ -208,19 +183,11 @@ uzbl_commands_run_parsed (const UzblCommand *info, GArray *argv, GString *result
         return;
     }
 
-    info->function (argv, result);
+    gint64 start = g_get_monotonic_time ();
 
-    if (result) {
-        g_free (uzbl.state.last_result);
-        uzbl.state.last_result = g_strdup (result->str);
-    }
+    info->function (argv, result);
 
-    if (info->send_event) {
-        uzbl_events_send (COMMAND_EXECUTED, NULL,
-            TYPE_NAME, info->name,
-            TYPE_STR_ARRAY, argv,
-            NULL);
-    }
+    command_finished (info, argv, start, result);
 }
 
 void
@@ -251,17 +218,99 @@ uzbl_commands_run (const gchar *cmd, GString *result)
     uzbl_commands_args_free (argv);
 }
 
-typedef void (*UzblLineCallback) (const gchar *line, gpointer data);
+static GArray *
+spawn_args (GArray *argv);
+static GArray *
+spawn_sh_args (GArray *argv);
+static GConverter *
+trailing_line_stripper_new ();
+
+GInputStream *
+uzbl_commands_run_stream (const UzblCommand *info, GArray *argv, GError **error)
+{
+    GArray *args = NULL;
+    gboolean strip = FALSE;
+
+    if (!info) {
+        return NULL;
+    }
+
+    if (!g_strcmp0 (info->name, "spawn_sync")) {
+        args = spawn_args (argv);
+    } else if (!g_strcmp0 (info->name, "spawn_sh_sync")) {
+        args = spawn_sh_args (argv);
+        strip = TRUE;
+    }
+
+    if (!args) {
+        return NULL;
+    }
+
+    gint64 start = g_get_monotonic_time ();
+    gint out = -1;
+    GInputStream *stream = NULL;
+
+    if (g_spawn_async_with_pipes (NULL, (gchar **)args->data, NULL, G_SPAWN_SEARCH_PATH,
+            NULL, NULL, NULL, NULL, &out, NULL, error)) {
+        stream = g_unix_input_stream_new (out, TRUE);
+    }
+
+    static UzblStatsEntry *stream_stats = NULL;
+
+    uzbl_stats_record_cached (&stream_stats, UZBL_STATS_SPAWNS, "stream", start, 0);
+
+    uzbl_commands_args_free (args);
+
+    if (!stream) {
+        return NULL;
+    }
+
+    /* spawn_sh_sync drops its output from the last newline on (see
+     * spawn_sh), which has to be done as the output goes by here. */
+    if (strip) {
+        GConverter *stripper = trailing_line_stripper_new ();
+        GInputStream *stripped = g_converter_input_stream_new (stream, stripper);
+
+        g_object_unref (stripper);
+        g_object_unref (stream);
+        stream = stripped;
+    }
+
+    /* The output is not known yet, so the last result is left alone. */
+    command_finished (info, argv, start, NULL);
+
+    return stream;
+}
+
+typedef void (*UzblLineCallback) (gchar *line, gpointer data);
 
 static gboolean
 for_each_line_in_file (const gchar *path, UzblLineCallback callback, gpointer data);
 static void
-parse_command_from_file_cb (const gchar *line, gpointer data);
+parse_command_from_file_cb (gchar *line, gpointer data);
 
 void
 uzbl_commands_load_file (const gchar *path)
 {
-    if (!for_each_line_in_file (path, parse_command_from_file_cb, NULL)) {
+    gboolean ok = TRUE;
+    guint span = uzbl_timeline_begin ("load_file", path);
+    UzblConfigCache *cache = uzbl_config_cache_new (path);
+
+    /* Redraw the status bar and title once, not after every set. */
+    uzbl_gui_freeze_title ();
+    if (!cache || !uzbl_config_cache_replay (cache)) {
+        ok = for_each_line_in_file (path, parse_command_from_file_cb, cache);
+
+        if (ok && cache) {
+            uzbl_config_cache_save (cache);
+        }
+    }
+    uzbl_gui_thaw_title ();
+
+    uzbl_config_cache_free (cache);
+    uzbl_timeline_end (span);
+
+    if (!ok) {
         gchar *tmp = g_strdup_printf ("File %s can not be read.", path);
         uzbl_events_send (COMMAND_ERROR, NULL,
             TYPE_STR, tmp,
@@ -273,6 +322,168 @@ uzbl_commands_load_file (const gchar *path)
 
 /* ===================== HELPER IMPLEMENTATIONS ===================== */
 
+void
+command_finished (const UzblCommand *info, GArray *argv, gint64 start, GString *result)
+{
+    uzbl_stats_record_cached (&uzbl.commands->stats[info - builtin_command_table],
+        UZBL_STATS_COMMANDS, info->name, start, 0);
+
+    if (result) {
+        g_free (uzbl.state.last_result);
+        uzbl.state.last_result = g_strdup (result->str);
+    }
+
+    if (info->send_event) {
+        uzbl_events_send (COMMAND_EXECUTED, NULL,
+            TYPE_NAME, info->name,
+            TYPE_STR_ARRAY, argv,
+            NULL);
+    }
+}
+
+/* A converter which drops everything from the last newline on, like
+ * remove_trailing_newline, holding back the data after each newline until
+ * the next one (or the end of the input) shows whether it is the last. */
+typedef struct {
+    GObject   parent;
+
+    /* Data known to come before the last newline. */
+    GString  *ready;
+    /* Data from the latest newline on. */
+    GString  *held;
+    gboolean  newline_seen;
+} UzblTrailingLineStripper;
+
+typedef struct {
+    GObjectClass parent_class;
+} UzblTrailingLineStripperClass;
+
+static void
+trailing_line_stripper_iface_init (GConverterIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (UzblTrailingLineStripper, trailing_line_stripper, G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE (G_TYPE_CONVERTER, trailing_line_stripper_iface_init))
+
+static void
+trailing_line_stripper_finalize (GObject *object);
+
+void
+trailing_line_stripper_class_init (UzblTrailingLineStripperClass *cls)
+{
+    G_OBJECT_CLASS (cls)->finalize = trailing_line_stripper_finalize;
+}
+
+void
+trailing_line_stripper_init (UzblTrailingLineStripper *stripper)
+{
+    stripper->ready = g_string_new ("");
+    stripper->held = g_string_new ("");
+    stripper->newline_seen = FALSE;
+}
+
+void
+trailing_line_stripper_finalize (GObject *object)
+{
+    UzblTrailingLineStripper *stripper = (UzblTrailingLineStripper *)object;
+
+    g_string_free (stripper->ready, TRUE);
+    g_string_free (stripper->held, TRUE);
+
+    G_OBJECT_CLASS (trailing_line_stripper_parent_class)->finalize (object);
+}
+
+GConverter *
+trailing_line_stripper_new ()
+{
+    return G_CONVERTER (g_object_new (trailing_line_stripper_get_type (), NULL));
+}
+
+static GConverterResult
+trailing_line_stripper_convert (GConverter *converter,
+                                const void *inbuf, gsize inbuf_size,
+                                void *outbuf, gsize outbuf_size,
+                                GConverterFlags flags,
+                                gsize *bytes_read, gsize *bytes_written,
+                                GError **error);
+static void
+trailing_line_stripper_reset (GConverter *converter);
+
+void
+trailing_line_stripper_iface_init (GConverterIface *iface)
+{
+    iface->convert = trailing_line_stripper_convert;
+    iface->reset = trailing_line_stripper_reset;
+}
+
+GConverterResult
+trailing_line_stripper_convert (GConverter *converter,
+                                const void *inbuf, gsize inbuf_size,
+                                void *outbuf, gsize outbuf_size,
+                                GConverterFlags flags,
+                                gsize *bytes_read, gsize *bytes_written,
+                                GError **error)
+{
+    UzblTrailingLineStripper *stripper = (UzblTrailingLineStripper *)converter;
+    const gchar *in = inbuf;
+    const gchar *newline = NULL;
+    gboolean at_end = (flags & G_CONVERTER_INPUT_AT_END);
+    gsize i;
+
+    for (i = inbuf_size; !newline && i; --i) {
+        if (in[i - 1] == '\n') {
+            newline = in + i - 1;
+        }
+    }
+
+    if (newline) {
+        g_string_append_len (stripper->ready, stripper->held->str, stripper->held->len);
+        g_string_append_len (stripper->ready, in, newline - in);
+        g_string_truncate (stripper->held, 0);
+        g_string_append_len (stripper->held, newline, inbuf_size - (newline - in));
+        stripper->newline_seen = TRUE;
+    } else {
+        g_string_append_len (stripper->held, in, inbuf_size);
+    }
+
+    /* Output without any newline is passed on whole. */
+    if (at_end) {
+        if (!stripper->newline_seen) {
+            g_string_append_len (stripper->ready, stripper->held->str, stripper->held->len);
+        }
+        g_string_truncate (stripper->held, 0);
+    }
+
+    gsize len = MIN (stripper->ready->len, outbuf_size);
+
+    memcpy (outbuf, stripper->ready->str, len);
+    g_string_erase (stripper->ready, 0, len);
+
+    *bytes_read = inbuf_size;
+    *bytes_written = len;
+
+    if (at_end && !stripper->ready->len) {
+        return G_CONVERTER_FINISHED;
+    }
+
+    if (!inbuf_size && !len) {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+            "Need more input");
+        return G_CONVERTER_ERROR;
+    }
+
+    return G_CONVERTER_CONVERTED;
+}
+
+void
+trailing_line_stripper_reset (GConverter *converter)
+{
+    UzblTrailingLineStripper *stripper = (UzblTrailingLineStripper *)converter;
+
+    g_string_truncate (stripper->ready, 0);
+    g_string_truncate (stripper->held, 0);
+    stripper->newline_seen = FALSE;
+}
+
 static JSValueRef
 call_command (JSContextRef ctx, JSObjectRef function, JSObjectRef thisObject, size_t argumentCount, const JSValueRef arguments[], JSValueRef* exception);
 
@@ -329,6 +540,61 @@ init_js_commands_api ()
     JSClassRelease (command_class);
 }
 
+static void
+parse_command_arguments (const gchar *args, GArray *argv, gboolean split);
+
+const UzblCommand *
+parse_traced (const gchar *cmd, GArray *argv, UzblExpandTrace *trace)
+{
+    if (!cmd || cmd[0] == '#' || !*cmd) {
+        return NULL;
+    }
+
+    const gchar *line = cmd;
+    gchar *exp_line = NULL;
+
+    /* Expansion leaves lines without an '@' untouched, so skip it. */
+    if (strchr (cmd, '@')) {
+        exp_line = uzbl_variables_expand_traced (cmd, trace);
+        line = exp_line;
+    }
+
+    if (!line || !*line) {
+        g_free (exp_line);
+        return NULL;
+    }
+
+    /* Separate the line into the command and its parameters. */
+    const gchar *space = strchr (line, ' ');
+
+    gchar *command = space ? g_strndup (line, space - line) : g_strdup (line);
+    const gchar *arg_string = space ? space + 1 : NULL;
+
+    /* Look up the command. */
+    const UzblCommand *info = g_hash_table_lookup (uzbl.commands->table, command);
+
+    if (!info) {
+        uzbl_events_send (COMMAND_ERROR, NULL,
+            TYPE_STR, command,
+            NULL);
+
+        g_free (exp_line);
+        g_free (command);
+
+        return NULL;
+    }
+
+    /* Parse the arguments. */
+    if (argv && arg_string) {
+        parse_command_arguments (arg_string, argv, info->split);
+    }
+
+    g_free (exp_line);
+    g_free (command);
+
+    return info;
+}
+
 static GArray *
 split_quoted (const gchar *src);
 
@@ -360,8 +626,50 @@ parse_command_arguments (const gchar *args, GArray *argv, gboolean split)
     uzbl_commands_args_free (par);
 }
 
+static gboolean
+for_each_line_in_channel (const gchar *path, UzblLineCallback callback, gpointer data);
+
 gboolean
 for_each_line_in_file (const gchar *path, UzblLineCallback callback, gpointer data)
+{
+    GMappedFile *file = g_mapped_file_new (path, FALSE, NULL);
+
+    if (!file) {
+        /* Not something that can be mapped (e.g., a FIFO). */
+        return for_each_line_in_channel (path, callback, data);
+    }
+
+    const gchar *p = g_mapped_file_get_contents (file);
+    const gchar *end = p + g_mapped_file_get_length (file);
+
+    /* The mapping is read-only and not NUL-terminated, so each line is copied
+     * into a single reused buffer. */
+    GString *line = g_string_sized_new (256);
+
+    while (p && (p < end)) {
+        const gchar *eol = memchr (p, '\n', end - p);
+        const gchar *next = eol ? eol + 1 : end;
+
+        if (!eol) {
+            eol = end;
+        }
+
+        g_string_truncate (line, 0);
+        g_string_append_len (line, p, eol - p);
+
+        callback (line->str, data);
+
+        p = next;
+    }
+
+    g_string_free (line, TRUE);
+    g_mapped_file_unref (file);
+
+    return TRUE;
+}
+
+gboolean
+for_each_line_in_channel (const gchar *path, UzblLineCallback callback, gpointer data)
 {
     gchar *line = NULL;
     gsize len;
@@ -383,14 +691,14 @@ for_each_line_in_file (const gchar *path, UzblLineCallback callback, gpointer da
 }
 
 static void
-parse_command_from_file (const char *cmd);
+parse_command_from_file (gchar *cmd, UzblConfigCache *cache);
 
 void
-parse_command_from_file_cb (const gchar *line, gpointer data)
+parse_command_from_file_cb (gchar *line, gpointer data)
 {
-    UZBL_UNUSED (data);
+    UzblConfigCache *cache = (UzblConfigCache *)data;
 
-    parse_command_from_file (line);
+    parse_command_from_file (line, cache);
 }
 
 JSValueRef
@@ -527,18 +835,42 @@ unescape (gchar *src)
 }
 
 void
-parse_command_from_file (const char *cmd)
+parse_command_from_file (gchar *cmd, UzblConfigCache *cache)
 {
     if (!cmd || !*cmd) {
         return;
     }
 
-    /* Strip trailing newline, and any other whitespace in front. */
-    gchar *work_string = g_strdup (cmd);
-    g_strstrip (work_string);
+    /* Strip trailing newline, and any other whitespace in front. The line
+     * buffer belongs to the reader, so this is done in place. */
+    g_strstrip (cmd);
+
+    if (!cache) {
+        uzbl_commands_run (cmd, NULL);
+        return;
+    }
+
+    if (!*cmd || (*cmd == '#')) {
+        return;
+    }
+
+    UzblExpandTrace trace;
+    trace.cacheable = TRUE;
+    trace.inputs = g_hash_table_new_full (g_str_hash, g_str_equal,
+        g_free, g_free);
 
-    uzbl_commands_run (work_string, NULL);
-    g_free (work_string);
+    GArray *argv = uzbl_commands_args_new ();
+    const UzblCommand *info = parse_traced (cmd, argv, &trace);
+
+    /* Record before running since commands may modify their arguments. */
+    uzbl_config_cache_add (cache, cmd,
+        (info && trace.cacheable) ? info->name : NULL,
+        argv, trace.inputs);
+
+    uzbl_commands_run_parsed (info, argv, NULL);
+
+    uzbl_commands_args_free (argv);
+    g_hash_table_destroy (trace.inputs);
 }
 
 /* ========================= COMMAND TABLE ========================== */
@@ -561,6 +893,7 @@ DECLARE_COMMAND (reload);
 DECLARE_COMMAND (stop);
 DECLARE_COMMAND (uri);
 DECLARE_COMMAND (download);
+DECLARE_COMMAND (preconnect);
 
 /* Page commands */
 DECLARE_COMMAND (load);
@@ -620,6 +953,7 @@ DECLARE_COMMAND (spawn_sh_sync);
 DECLARE_COMMAND (chain);
 DECLARE_COMMAND (include);
 DECLARE_COMMAND (exit);
+DECLARE_COMMAND (stats);
 
 /* Variable commands */
 DECLARE_COMMAND (set);
@@ -643,6 +977,7 @@ builtin_command_table[] = {
     { "stop",                           cmd_stop,                     TRUE,  TRUE  },
     { "uri",                            cmd_uri,                      TRUE, TRUE  },
     { "download",                       cmd_download,                 TRUE,  TRUE  },
+    { "preconnect",                     cmd_preconnect,               TRUE,  FALSE },
 
     /* Page commands */
     { "load",                           cmd_load,                     TRUE,  TRUE  },
@@ -699,6 +1034,7 @@ builtin_command_table[] = {
     { "chain",                          cmd_chain,                    TRUE,  TRUE  },
     { "include",                        cmd_include,                  FALSE, TRUE  },
     { "exit",                           cmd_exit,                     TRUE,  TRUE  },
+    { "stats",                          cmd_stats,                    TRUE,  FALSE },
 
     /* Variable commands */
     { "set",                            cmd_set,                      FALSE, FALSE },
@@ -839,6 +1175,15 @@ IMPLEMENT_COMMAND (download)
     g_object_unref (download);
 }
 
+IMPLEMENT_COMMAND (preconnect)
+{
+    UZBL_UNUSED (result);
+
+    ARG_CHECK (argv, 1);
+
+    uzbl_soup_preconnect (uzbl.net.soup_session, argv_idx (argv, 0));
+}
+
 /* Page commands */
 
 IMPLEMENT_COMMAND (load)
@@ -936,8 +1281,6 @@ IMPLEMENT_COMMAND (frame)
 
 IMPLEMENT_COMMAND (cookie)
 {
-    UZBL_UNUSED (result);
-
     ARG_CHECK (argv, 1);
 
     const gchar *command = argv_idx (argv, 0);
@@ -1007,7 +1350,21 @@ IMPLEMENT_COMMAND (cookie)
 
         const gchar *type = argv_idx (argv, 1);
 
-        if (!g_strcmp0 (type, "all")) {
+        if (!g_strcmp0 (type, "all") && uzbl.net.soup_cookie_jar->shared_path) {
+            /* Delete each cookie so that other instances sharing the jar
+             * see the deletions. */
+            SoupCookieJar *jar = SOUP_COOKIE_JAR (uzbl.net.soup_cookie_jar);
+            GSList *cookies = soup_cookie_jar_all_cookies (jar);
+            GSList *cookie;
+
+            uzbl.net.soup_cookie_jar->in_manual_add = 1;
+            for (cookie = cookies; cookie; cookie = cookie->next) {
+                soup_cookie_jar_delete_cookie (jar, cookie->data);
+            }
+            uzbl.net.soup_cookie_jar->in_manual_add = 0;
+
+            g_slist_free_full (cookies, (GDestroyNotify)soup_cookie_free);
+        } else if (!g_strcmp0 (type, "all")) {
             /* Replace the current cookie jar with a new empty jar. */
             soup_session_remove_feature (uzbl.net.soup_session,
                 SOUP_SESSION_FEATURE (uzbl.net.soup_cookie_jar));
@@ -1018,6 +1375,29 @@ IMPLEMENT_COMMAND (cookie)
         } else {
             uzbl_debug ("Unrecognized cookie clear type: %s\n", type);
         }
+    } else if (!g_strcmp0 (command, "load")) {
+        ARG_CHECK (argv, 2);
+
+        const gchar *path = argv_idx (argv, 1);
+        GError *error = NULL;
+        gint count = uzbl_cookie_jar_load_text (uzbl.net.soup_cookie_jar, path, &error);
+
+        if (count < 0) {
+            uzbl_debug ("Failed to load cookie file %s: %s\n", path, error->message);
+            g_error_free (error);
+        } else if (result) {
+            g_string_append_printf (result, "%d", count);
+        }
+    } else if (!g_strcmp0 (command, "save")) {
+        ARG_CHECK (argv, 2);
+
+        const gchar *path = argv_idx (argv, 1);
+        GError *error = NULL;
+
+        if (!uzbl_cookie_jar_save_text (uzbl.net.soup_cookie_jar, path, &error)) {
+            uzbl_debug ("Failed to save cookie file %s: %s\n", path, error->message);
+            g_error_free (error);
+        }
     } else {
         uzbl_debug ("Unrecognized cookie command: %s\n", command);
     }
@@ -2156,6 +2536,19 @@ IMPLEMENT_COMMAND (exit)
     uzbl_io_quit ();
 }
 
+IMPLEMENT_COMMAND (stats)
+{
+    const gchar *group = argv->len ? argv_idx (argv, 0) : NULL;
+
+    if (!result) {
+        return;
+    }
+
+    if (!uzbl_stats_to_json (result, group)) {
+        uzbl_debug ("Unrecognized stats group: %s\n", group);
+    }
+}
+
 /* Variable commands */
 
 IMPLEMENT_COMMAND (set)
@@ -2345,24 +2738,7 @@ spawn (GArray *argv, GString *result, gboolean exec)
 {
     ARG_CHECK (argv, 1);
 
-    const gchar *req_path = argv_idx (argv, 0);
-
-    gchar *path = find_existing_file (req_path);
-
-    if (!path) {
-        /* Assume it's a valid command. */
-        path = g_strdup (req_path);
-    }
-
-    GArray *args = uzbl_commands_args_new ();
-
-    uzbl_commands_args_append (args, path);
-
-    guint i;
-    for (i = 1; i < argv->len; ++i) {
-        const gchar *arg = argv_idx (argv, i);
-        uzbl_commands_args_append (args, g_strdup (arg));
-    }
+    GArray *args = spawn_args (argv);
 
     gchar *r = NULL;
     run_system_command (args, result ? &r : NULL);
@@ -2374,7 +2750,7 @@ spawn (GArray *argv, GString *result, gboolean exec)
             gchar *tail;
             while ((tail = strchr (head, '\n'))) {
                 *tail = '\0';
-                parse_command_from_file (head);
+                parse_command_from_file (head, NULL);
                 head = tail + 1;
             }
         }
@@ -2386,20 +2762,68 @@ spawn (GArray *argv, GString *result, gboolean exec)
 
 void
 spawn_sh (GArray *argv, GString *result)
+{
+    GArray *sh_cmd = spawn_sh_args (argv);
+    if (!sh_cmd) {
+        return;
+    }
+
+    gchar *r = NULL;
+    run_system_command (sh_cmd, result ? &r : NULL);
+    if (result && r) {
+        remove_trailing_newline (r);
+        g_string_append (result, r);
+    }
+
+    g_free (r);
+    uzbl_commands_args_free (sh_cmd);
+}
+
+GArray *
+spawn_args (GArray *argv)
+{
+    if (!argv->len) {
+        return NULL;
+    }
+
+    const gchar *req_path = argv_idx (argv, 0);
+
+    gchar *path = find_existing_file (req_path);
+
+    if (!path) {
+        /* Assume it's a valid command. */
+        path = g_strdup (req_path);
+    }
+
+    GArray *args = uzbl_commands_args_new ();
+
+    uzbl_commands_args_append (args, path);
+
+    guint i;
+    for (i = 1; i < argv->len; ++i) {
+        const gchar *arg = argv_idx (argv, i);
+        uzbl_commands_args_append (args, g_strdup (arg));
+    }
+
+    return args;
+}
+
+GArray *
+spawn_sh_args (GArray *argv)
 {
     gchar *shell = uzbl_variables_get_string ("shell_cmd");
 
     if (!*shell) {
         uzbl_debug ("spawn_sh: shell_cmd is not set!\n");
         g_free (shell);
-        return;
+        return NULL;
     }
     guint i;
 
     GArray *sh_cmd = split_quoted (shell);
     g_free (shell);
     if (!sh_cmd) {
-        return;
+        return NULL;
     }
 
     for (i = 0; i < argv->len; ++i) {
@@ -2407,15 +2831,7 @@ spawn_sh (GArray *argv, GString *result)
         uzbl_commands_args_append (sh_cmd, g_strdup (arg));
     }
 
-    gchar *r = NULL;
-    run_system_command (sh_cmd, result ? &r : NULL);
-    if (result && r) {
-        remove_trailing_newline (r);
-        g_string_append (result, r);
-    }
-
-    g_free (r);
-    uzbl_commands_args_free (sh_cmd);
+    return sh_cmd;
 }
 
 void
@@ -2462,6 +2878,7 @@ gboolean
 run_system_command (GArray *args, char **output_stdout)
 {
     GError *err = NULL;
+    gint64 start = g_get_monotonic_time ();
 
     gboolean result;
     if (output_stdout) {
@@ -2475,6 +2892,11 @@ run_system_command (GArray *args, char **output_stdout)
                                 NULL, NULL, NULL, &err);
     }
 
+    static UzblStatsEntry *spawn_stats[2];
+
+    uzbl_stats_record_cached (&spawn_stats[output_stdout ? 1 : 0], UZBL_STATS_SPAWNS,
+        output_stdout ? "sync" : "async", start, 0);
+
     if (uzbl_variables_get_int ("verbose")) {
         GString *s = g_string_new ("spawned:");
         guint i;
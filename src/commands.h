@@ -1,7 +1,7 @@
 #ifndef UZBL_COMMANDS_H
 #define UZBL_COMMANDS_H
 
-#include <glib.h>
+#include <gio/gio.h>
 
 struct _UzblCommand;
 typedef struct _UzblCommand UzblCommand;
@@ -21,6 +21,11 @@ void
 uzbl_commands_run_argv (const gchar *cmd, GArray *argv, GString *result);
 void
 uzbl_commands_run (const gchar *cmd, GString *result);
+/* Starts a spawn_sync or spawn_sh_sync command and returns a stream of its
+ * output (the same output the command would return) instead of waiting for
+ * it. Returns NULL without setting error for any other command. */
+GInputStream *
+uzbl_commands_run_stream (const UzblCommand *info, GArray *argv, GError **error);
 
 void
 uzbl_commands_load_file (const gchar *path);
@@ -0,0 +1,333 @@
+#include "config-cache.h"
+
+#include "commands.h"
+#include "util.h"
+#include "uzbl-core.h"
+#include "variables.h"
+
+#include <gio/gio.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/* A snapshot is stored as a GVariant of the following form:
+ *
+ *   (commit, mtime, size, environment, [(line, command, argv, inputs)])
+ *
+ * where mtime (in microseconds, so that edits within the same second are
+ * noticed) and size are those of the file when it was recorded and the
+ * environment is a checksum of the environment (minus the per-instance UZBL_*
+ * variables) that shell expansions ran in. */
+#define UZBL_CONFIG_CACHE_ENTRY  "(ssasa{ss})"
+#define UZBL_CONFIG_CACHE_FORMAT "(sxts" "a" UZBL_CONFIG_CACHE_ENTRY ")"
+
+struct _UzblConfigCache {
+    gchar           *path;
+    gint64           mtime;
+    guint64          size;
+    gchar           *environment;
+
+    GVariantBuilder *entries;
+    gboolean         unusable;
+};
+
+/* =========================== PUBLIC API =========================== */
+
+static gchar *
+snapshot_path (const gchar *dir, const gchar *path);
+static gchar *
+environment_checksum ();
+
+UzblConfigCache *
+uzbl_config_cache_new (const gchar *path)
+{
+    const gchar *dir = uzbl.state.config_cache_dir;
+
+    if (!dir || !*dir) {
+        return NULL;
+    }
+
+    /* struct stat only has sub-second times from POSIX.1-2008 on. */
+    GFile *file = g_file_new_for_path (path);
+    GFileInfo *info = g_file_query_info (file,
+        G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+        G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+        G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+        G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+        G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+    g_object_unref (file);
+
+    if (!info) {
+        return NULL;
+    }
+
+    if (g_file_info_get_file_type (info) != G_FILE_TYPE_REGULAR) {
+        g_object_unref (info);
+        return NULL;
+    }
+
+    UzblConfigCache *cache = g_malloc0 (sizeof (UzblConfigCache));
+
+    cache->path = snapshot_path (dir, path);
+    cache->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC;
+    cache->mtime += g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+    cache->size = g_file_info_get_size (info);
+    cache->environment = environment_checksum ();
+    cache->entries = g_variant_builder_new (G_VARIANT_TYPE ("a" UZBL_CONFIG_CACHE_ENTRY));
+    cache->unusable = FALSE;
+
+    g_object_unref (info);
+
+    return cache;
+}
+
+void
+uzbl_config_cache_free (UzblConfigCache *cache)
+{
+    if (!cache) {
+        return;
+    }
+
+    g_variant_builder_unref (cache->entries);
+    g_free (cache->environment);
+    g_free (cache->path);
+
+    g_free (cache);
+}
+
+static void
+replay_entry (const gchar *line, const gchar *command, const gchar **args, GVariant *inputs);
+
+gboolean
+uzbl_config_cache_replay (UzblConfigCache *cache)
+{
+    GMappedFile *file = g_mapped_file_new (cache->path, FALSE, NULL);
+
+    if (!file) {
+        return FALSE;
+    }
+
+    GBytes *bytes = g_mapped_file_get_bytes (file);
+    GVariant *snapshot = g_variant_new_from_bytes (G_VARIANT_TYPE (UZBL_CONFIG_CACHE_FORMAT),
+        bytes, FALSE);
+    g_bytes_unref (bytes);
+    g_mapped_file_unref (file);
+
+    g_variant_ref_sink (snapshot);
+
+    const gchar *commit;
+    gint64 mtime;
+    guint64 size;
+    const gchar *environment;
+    GVariantIter *entries;
+
+    g_variant_get (snapshot, "(&sxt&sa" UZBL_CONFIG_CACHE_ENTRY ")",
+        &commit, &mtime, &size, &environment, &entries);
+
+    gboolean valid = !g_strcmp0 (commit, COMMIT) &&
+                     (mtime == cache->mtime) &&
+                     (size == cache->size) &&
+                     !g_strcmp0 (environment, cache->environment);
+
+    if (valid) {
+        const gchar *line;
+        const gchar *command;
+        const gchar **args;
+        GVariant *inputs;
+
+        while (g_variant_iter_loop (entries, "(&s&s^a&s@a{ss})", &line, &command, &args, &inputs)) {
+            replay_entry (line, command, args, inputs);
+        }
+    } else {
+        uzbl_debug ("Config snapshot %s is out of date\n", cache->path);
+    }
+
+    g_variant_iter_free (entries);
+    g_variant_unref (snapshot);
+
+    return valid;
+}
+
+void
+uzbl_config_cache_add (UzblConfigCache *cache, const gchar *line, const gchar *command, GArray *argv, GHashTable *inputs)
+{
+    if (cache->unusable) {
+        return;
+    }
+
+    /* GVariant strings must be valid UTF-8. */
+    if (!g_utf8_validate (line, -1, NULL)) {
+        cache->unusable = TRUE;
+        return;
+    }
+
+    GVariantBuilder args;
+    GVariantBuilder values;
+
+    g_variant_builder_init (&args, G_VARIANT_TYPE_STRING_ARRAY);
+    g_variant_builder_init (&values, G_VARIANT_TYPE ("a{ss}"));
+
+    if (command) {
+        gboolean complete = TRUE;
+        guint i;
+
+        for (i = 0; complete && (i < argv->len); ++i) {
+            const gchar *arg = argv_idx (argv, i);
+
+            if ((complete = g_utf8_validate (arg, -1, NULL))) {
+                g_variant_builder_add (&args, "s", arg);
+            }
+        }
+
+        GHashTableIter iter;
+        gpointer name;
+        gpointer value;
+
+        g_hash_table_iter_init (&iter, inputs);
+        while (complete && g_hash_table_iter_next (&iter, &name, &value)) {
+            if ((complete = g_utf8_validate (value, -1, NULL))) {
+                g_variant_builder_add (&values, "{ss}", name, value);
+            }
+        }
+
+        /* Fall back to running the line as-is if anything was skipped. */
+        if (!complete) {
+            command = NULL;
+        }
+    }
+
+    g_variant_builder_add (cache->entries, UZBL_CONFIG_CACHE_ENTRY,
+        line, command ? command : "", &args, &values);
+}
+
+void
+uzbl_config_cache_save (UzblConfigCache *cache)
+{
+    if (cache->unusable) {
+        return;
+    }
+
+    GVariant *snapshot = g_variant_new ("(sxts@a" UZBL_CONFIG_CACHE_ENTRY ")",
+        COMMIT, cache->mtime, cache->size, cache->environment,
+        g_variant_builder_end (cache->entries));
+
+    g_variant_ref_sink (snapshot);
+
+    gchar *dir = g_path_get_dirname (cache->path);
+    GError *error = NULL;
+
+    if (g_mkdir_with_parents (dir, 0700)) {
+        g_warning ("Failed to create config cache directory %s\n", dir);
+    } else if (!g_file_set_contents (cache->path,
+            g_variant_get_data (snapshot), g_variant_get_size (snapshot),
+            &error)) {
+        g_warning ("Failed to write config snapshot %s: %s\n", cache->path, error->message);
+        g_error_free (error);
+    }
+
+    g_free (dir);
+    g_variant_unref (snapshot);
+}
+
+/* ===================== HELPER IMPLEMENTATIONS ===================== */
+
+gchar *
+snapshot_path (const gchar *dir, const gchar *path)
+{
+    gchar *abs_path = NULL;
+
+    if (g_path_is_absolute (path)) {
+        abs_path = g_strdup (path);
+    } else {
+        gchar *cwd = g_get_current_dir ();
+        abs_path = g_build_filename (cwd, path, NULL);
+        g_free (cwd);
+    }
+
+    gchar *name = g_compute_checksum_for_string (G_CHECKSUM_SHA1, abs_path, -1);
+    gchar *snapshot = g_build_filename (dir, name, NULL);
+
+    g_free (name);
+    g_free (abs_path);
+
+    return snapshot;
+}
+
+static int
+compare_strings (const void *a, const void *b);
+
+gchar *
+environment_checksum ()
+{
+    gchar **env = g_get_environ ();
+    gchar **var;
+
+    qsort (env, g_strv_length (env), sizeof (gchar *), compare_strings);
+
+    GChecksum *checksum = g_checksum_new (G_CHECKSUM_SHA1);
+
+    for (var = env; *var; ++var) {
+        if (g_str_has_prefix (*var, "UZBL_")) {
+            continue;
+        }
+
+        /* Include the terminator to separate the variables. */
+        g_checksum_update (checksum, (const guchar *)*var, strlen (*var) + 1);
+    }
+
+    gchar *result = g_strdup (g_checksum_get_string (checksum));
+
+    g_checksum_free (checksum);
+    g_strfreev (env);
+
+    return result;
+}
+
+static gboolean
+inputs_unchanged (GVariant *inputs);
+
+void
+replay_entry (const gchar *line, const gchar *command, const gchar **args, GVariant *inputs)
+{
+    if (!*command || !inputs_unchanged (inputs)) {
+        uzbl_commands_run (line, NULL);
+        return;
+    }
+
+    GArray *argv = uzbl_commands_args_new ();
+
+    while (args && *args) {
+        uzbl_commands_args_append (argv, g_strdup (*args++));
+    }
+
+    uzbl_commands_run_argv (command, argv, NULL);
+
+    uzbl_commands_args_free (argv);
+}
+
+int
+compare_strings (const void *a, const void *b)
+{
+    return strcmp (*(const gchar * const *)a, *(const gchar * const *)b);
+}
+
+gboolean
+inputs_unchanged (GVariant *inputs)
+{
+    GVariantIter iter;
+    const gchar *name;
+    const gchar *value;
+    gboolean unchanged = TRUE;
+
+    g_variant_iter_init (&iter, inputs);
+    while (unchanged && g_variant_iter_next (&iter, "{&s&s}", &name, &value)) {
+        gchar *current = uzbl_variables_get_expanded (name);
+
+        unchanged = !g_strcmp0 (current, value);
+
+        g_free (current);
+    }
+
+    return unchanged;
+}
@@ -0,0 +1,28 @@
+#ifndef UZBL_CONFIG_CACHE_H
+#define UZBL_CONFIG_CACHE_H
+
+#include <glib.h>
+
+struct _UzblConfigCache;
+typedef struct _UzblConfigCache UzblConfigCache;
+
+/* Returns NULL if caching is disabled or the file can not be cached. */
+UzblConfigCache *
+uzbl_config_cache_new (const gchar *path);
+void
+uzbl_config_cache_free (UzblConfigCache *cache);
+
+/* Runs the commands from a valid snapshot of the file. Returns FALSE if there
+ * is no usable snapshot and the file needs to be loaded normally. */
+gboolean
+uzbl_config_cache_replay (UzblConfigCache *cache);
+
+/* Records a line of the file. If command is NULL, the line is run as-is when
+ * replayed, otherwise the command is run with argv as long as the variables
+ * in inputs still have the same values. */
+void
+uzbl_config_cache_add (UzblConfigCache *cache, const gchar *line, const gchar *command, GArray *argv, GHashTable *inputs);
+void
+uzbl_config_cache_save (UzblConfigCache *cache);
+
+#endif
@@ -2,9 +2,33 @@
 
 #include "events.h"
 #include "type.h"
+#include "util.h"
 
 #include <libsoup/soup.h>
 
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* The shared journal starts with a header carrying a generation which is
+ * bumped whenever the journal is compacted, followed by one line per change:
+ *
+ *   +|-  domain  path  name  value  flags  expires
+ *
+ * with tab-separated, escaped fields. */
+#define UZBL_SHARED_HEADER     "# uzbl cookies %08x\n"
+#define UZBL_SHARED_HEADER_LEN 24
+/* Compact the journal once it grows beyond this size (or twice the size of
+ * the last snapshot if that is larger). */
+#define UZBL_SHARED_MAX_SIZE   (1024 * 1024)
+
+/* Lines in a cookies.txt file for HttpOnly cookies carry this prefix. */
+#define UZBL_TEXT_HTTP_ONLY    "#HttpOnly_"
+
 /* =========================== PUBLIC API =========================== */
 
 static void
@@ -20,12 +44,200 @@ uzbl_cookie_jar_new ()
     return g_object_new (UZBL_TYPE_COOKIE_JAR, NULL);
 }
 
+static void
+shared_detach (UzblCookieJar *jar);
+static gboolean
+shared_lock (UzblCookieJar *jar, short type);
+static void
+shared_unlock (UzblCookieJar *jar);
+static void
+shared_read (UzblCookieJar *jar);
+static void
+shared_file_changed (GFileMonitor *monitor, GFile *file, GFile *other,
+                     GFileMonitorEvent event, gpointer data);
+
+gboolean
+uzbl_cookie_jar_set_shared (UzblCookieJar *jar, const gchar *path)
+{
+    shared_detach (jar);
+
+    if (!path || !*path) {
+        return TRUE;
+    }
+
+    int fd = open (path, O_RDWR | O_CREAT, 0600);
+
+    if (fd < 0) {
+        g_warning ("Failed to open shared cookie file %s: %s\n", path, strerror (errno));
+        return FALSE;
+    }
+
+    fcntl (fd, F_SETFD, FD_CLOEXEC);
+
+    jar->shared_fd = fd;
+    jar->shared_path = g_strdup (path);
+    jar->shared_generation = 0;
+    jar->shared_offset = 0;
+    jar->shared_compact_at = UZBL_SHARED_MAX_SIZE;
+    jar->shared_partial = g_string_new ("");
+
+    /* The first instance to use the file writes the header. */
+    if (shared_lock (jar, F_WRLCK)) {
+        struct stat st;
+
+        if (!fstat (fd, &st) && !st.st_size) {
+            gchar *header = g_strdup_printf (UZBL_SHARED_HEADER, 1);
+
+            if (pwrite (fd, header, UZBL_SHARED_HEADER_LEN, 0) != UZBL_SHARED_HEADER_LEN) {
+                g_warning ("Failed to write shared cookie file %s: %s\n", path, strerror (errno));
+            }
+
+            g_free (header);
+        }
+
+        shared_unlock (jar);
+    }
+
+    GFile *file = g_file_new_for_path (path);
+
+    jar->shared_monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, NULL);
+    if (jar->shared_monitor) {
+        g_signal_connect (G_OBJECT (jar->shared_monitor), "changed",
+            G_CALLBACK (shared_file_changed), jar);
+    }
+
+    g_object_unref (file);
+
+    shared_read (jar);
+
+    return TRUE;
+}
+
+static SoupCookie *
+parse_text_line (gchar *line);
+static gchar *
+cookie_key (SoupCookie *cookie);
+static void
+shared_write (UzblCookieJar *jar, GString *records);
+
+gint
+uzbl_cookie_jar_load_text (UzblCookieJar *jar, const gchar *path, GError **error)
+{
+    gchar *contents = NULL;
+
+    if (!g_file_get_contents (path, &contents, NULL, error)) {
+        return -1;
+    }
+
+    SoupCookieJar *soup_jar = SOUP_COOKIE_JAR (jar);
+    gchar *line = contents;
+    /* Cookies from the file which are still alive after the rows for them
+     * which follow. */
+    GHashTable *added = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    /* Journal records for the whole file are collected and written at once
+     * rather than taking the lock for each cookie. */
+    if (jar->shared_fd >= 0) {
+        jar->shared_batch = g_string_new ("");
+    }
+
+    /* Same as the add command: the event manager does not need to hear about
+     * cookies which came from its own files. */
+    jar->in_manual_add = 1;
+
+    while (line && *line) {
+        gchar *next = strchr (line, '\n');
+
+        if (next) {
+            *next++ = '\0';
+        }
+
+        SoupCookie *cookie = parse_text_line (line);
+
+        if (cookie) {
+            SoupDate *expires = soup_cookie_get_expires (cookie);
+            gchar *key = cookie_key (cookie);
+
+            if (!expires || !soup_date_is_past (expires)) {
+                g_hash_table_add (added, key);
+            } else {
+                g_hash_table_remove (added, key);
+                g_free (key);
+            }
+
+            /* The jar takes ownership of the cookie. An expired row (such as
+             * the one the event manager's text store appends when a cookie is
+             * deleted) removes the cookie it matches instead. */
+            soup_cookie_jar_add_cookie (soup_jar, cookie);
+        }
+
+        line = next;
+    }
+
+    jar->in_manual_add = 0;
+
+    if (jar->shared_batch) {
+        if (jar->shared_batch->len) {
+            shared_write (jar, jar->shared_batch);
+        }
+
+        g_string_free (jar->shared_batch, TRUE);
+        jar->shared_batch = NULL;
+    }
+
+    gint count = g_hash_table_size (added);
+
+    g_hash_table_destroy (added);
+    g_free (contents);
+
+    return count;
+}
+
+gboolean
+uzbl_cookie_jar_save_text (UzblCookieJar *jar, const gchar *path, GError **error)
+{
+    GString *buf = g_string_new ("# Netscape HTTP Cookie File\n\n");
+    GSList *cookies = soup_cookie_jar_all_cookies (SOUP_COOKIE_JAR (jar));
+    GSList *iter;
+
+    for (iter = cookies; iter; iter = iter->next) {
+        SoupCookie *cookie = iter->data;
+
+        g_string_append_printf (buf, "%s%s\t%s\t%s\t%s\t%ld\t%s\t%s\n",
+            cookie->http_only ? UZBL_TEXT_HTTP_ONLY : "",
+            cookie->domain,
+            (*cookie->domain == '.') ? "TRUE" : "FALSE",
+            cookie->path,
+            cookie->secure ? "TRUE" : "FALSE",
+            cookie->expires ? (long)soup_date_to_time_t (cookie->expires) : 0L,
+            cookie->name,
+            cookie->value);
+    }
+
+    gboolean ok = g_file_set_contents (path, buf->str, buf->len, error);
+
+    g_slist_free_full (cookies, (GDestroyNotify)soup_cookie_free);
+    g_string_free (buf, TRUE);
+
+    return ok;
+}
+
 /* ===================== HELPER IMPLEMENTATIONS ===================== */
 
 void
 soup_cookie_jar_socket_init (UzblCookieJar *jar)
 {
     jar->in_manual_add = 0;
+
+    jar->shared_path = NULL;
+    jar->shared_fd = -1;
+    jar->shared_generation = 0;
+    jar->shared_offset = 0;
+    jar->shared_compact_at = UZBL_SHARED_MAX_SIZE;
+    jar->shared_partial = NULL;
+    jar->shared_monitor = NULL;
+    jar->in_shared_replay = FALSE;
+    jar->shared_batch = NULL;
 }
 
 static void
@@ -40,6 +252,9 @@ soup_cookie_jar_socket_class_init (UzblCookieJarClass *socket_class)
     SOUP_COOKIE_JAR_CLASS (socket_class)->changed = changed;
 }
 
+static void
+shared_append (UzblCookieJar *jar, gchar op, SoupCookie *cookie);
+
 void
 changed (SoupCookieJar *jar, SoupCookie *old_cookie, SoupCookie *new_cookie)
 {
@@ -47,6 +262,18 @@ changed (SoupCookieJar *jar, SoupCookie *old_cookie, SoupCookie *new_cookie)
 
     UzblCookieJar *uzbl_jar = UZBL_COOKIE_JAR (jar);
 
+    /* Changes read from the shared journal came from another instance which
+     * already told its event manager about them. */
+    if (uzbl_jar->in_shared_replay) {
+        return;
+    }
+
+    /* Commands from the event manager (e.g., deleting a blacklisted cookie)
+     * are shared too so that every instance using the journal agrees. */
+    if (uzbl_jar->shared_fd >= 0) {
+        shared_append (uzbl_jar, new_cookie ? '+' : '-', cookie);
+    }
+
     /* Send a ADD_COOKIE or DELETE_COOKIE event depending on what has changed.
      * These events aren't sent when a cookie changes due to an add_cookie or
      * delete_cookie command because otherwise a loop would occur when a cookie
@@ -86,5 +313,485 @@ changed (SoupCookieJar *jar, SoupCookie *old_cookie, SoupCookie *new_cookie)
 void
 finalize (GObject *object)
 {
+    shared_detach (UZBL_COOKIE_JAR (object));
+
     G_OBJECT_CLASS (soup_cookie_jar_socket_parent_class)->finalize (object);
 }
+
+void
+shared_detach (UzblCookieJar *jar)
+{
+    if (jar->shared_monitor) {
+        g_file_monitor_cancel (jar->shared_monitor);
+        g_object_unref (jar->shared_monitor);
+        jar->shared_monitor = NULL;
+    }
+
+    if (jar->shared_fd >= 0) {
+        close (jar->shared_fd);
+        jar->shared_fd = -1;
+    }
+
+    if (jar->shared_partial) {
+        g_string_free (jar->shared_partial, TRUE);
+        jar->shared_partial = NULL;
+    }
+
+    g_free (jar->shared_path);
+    jar->shared_path = NULL;
+}
+
+gboolean
+shared_lock (UzblCookieJar *jar, short type)
+{
+    struct flock lock;
+
+    memset (&lock, 0, sizeof (lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+
+    while (fcntl (jar->shared_fd, F_SETLKW, &lock)) {
+        if (errno != EINTR) {
+            g_warning ("Failed to lock shared cookie file %s: %s\n", jar->shared_path, strerror (errno));
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+void
+shared_unlock (UzblCookieJar *jar)
+{
+    struct flock lock;
+
+    memset (&lock, 0, sizeof (lock));
+    lock.l_type = F_UNLCK;
+    lock.l_whence = SEEK_SET;
+
+    fcntl (jar->shared_fd, F_SETLK, &lock);
+}
+
+static void
+append_record (GString *buf, gchar op, SoupCookie *cookie);
+
+void
+shared_append (UzblCookieJar *jar, gchar op, SoupCookie *cookie)
+{
+    if (jar->shared_batch) {
+        append_record (jar->shared_batch, op, cookie);
+        return;
+    }
+
+    GString *record = g_string_new ("");
+
+    append_record (record, op, cookie);
+    shared_write (jar, record);
+
+    g_string_free (record, TRUE);
+}
+
+void
+shared_write (UzblCookieJar *jar, GString *records)
+{
+    if (!shared_lock (jar, F_WRLCK)) {
+        return;
+    }
+
+    struct stat st;
+
+    /* Other instances read up to the last newline, so the records are
+     * written in one piece while holding the lock. */
+    if (fstat (jar->shared_fd, &st) ||
+        (pwrite (jar->shared_fd, records->str, records->len, st.st_size) != (ssize_t)records->len)) {
+        g_warning ("Failed to write shared cookie file %s: %s\n", jar->shared_path, strerror (errno));
+    }
+
+    shared_unlock (jar);
+}
+
+static gboolean
+read_journal (UzblCookieJar *jar, GPtrArray *records, gboolean *restarted);
+static void
+apply_records (UzblCookieJar *jar, GPtrArray *records, gboolean restarted);
+static void
+compact_journal (UzblCookieJar *jar);
+
+void
+shared_read (UzblCookieJar *jar)
+{
+    GPtrArray *records = g_ptr_array_new_with_free_func (g_free);
+    gboolean ok = FALSE;
+    gboolean restarted = FALSE;
+
+    if (shared_lock (jar, F_RDLCK)) {
+        ok = read_journal (jar, records, &restarted);
+        shared_unlock (jar);
+    }
+
+    /* Apply the records outside of the lock since other instances may be
+     * waiting on it. */
+    apply_records (jar, records, restarted);
+
+    g_ptr_array_free (records, TRUE);
+
+    if (ok && (jar->shared_offset > jar->shared_compact_at)) {
+        compact_journal (jar);
+    }
+}
+
+void
+shared_file_changed (GFileMonitor *monitor, GFile *file, GFile *other,
+                     GFileMonitorEvent event, gpointer data)
+{
+    UZBL_UNUSED (monitor);
+    UZBL_UNUSED (file);
+    UZBL_UNUSED (other);
+
+    UzblCookieJar *jar = UZBL_COOKIE_JAR (data);
+
+    if (jar->shared_fd < 0) {
+        return;
+    }
+
+    switch (event) {
+    case G_FILE_MONITOR_EVENT_CHANGED:
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_CREATED:
+        shared_read (jar);
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+append_field (GString *buf, const gchar *field);
+
+void
+append_record (GString *buf, gchar op, SoupCookie *cookie)
+{
+    g_string_append_c (buf, op);
+    append_field (buf, cookie->domain);
+    append_field (buf, cookie->path);
+    append_field (buf, cookie->name);
+    append_field (buf, cookie->value);
+
+    g_string_append_c (buf, '\t');
+    if (cookie->secure) {
+        g_string_append_c (buf, 's');
+    }
+    if (cookie->http_only) {
+        g_string_append_c (buf, 'h');
+    }
+
+    g_string_append_c (buf, '\t');
+    if (cookie->expires) {
+        g_string_append_printf (buf, "%ld", (long)soup_date_to_time_t (cookie->expires));
+    }
+
+    g_string_append_c (buf, '\n');
+}
+
+gboolean
+read_journal (UzblCookieJar *jar, GPtrArray *records, gboolean *restarted)
+{
+    gchar header[UZBL_SHARED_HEADER_LEN + 1];
+    guint generation;
+
+    if (pread (jar->shared_fd, header, UZBL_SHARED_HEADER_LEN, 0) != UZBL_SHARED_HEADER_LEN) {
+        return FALSE;
+    }
+    header[UZBL_SHARED_HEADER_LEN] = '\0';
+
+    if (sscanf (header, UZBL_SHARED_HEADER, &generation) != 1) {
+        g_warning ("Unrecognized shared cookie file %s\n", jar->shared_path);
+        return FALSE;
+    }
+
+    gboolean restart = (generation != jar->shared_generation);
+
+    *restarted = restart;
+
+    /* The journal was compacted; start over from its snapshot. */
+    if (restart) {
+        jar->shared_generation = generation;
+        jar->shared_offset = UZBL_SHARED_HEADER_LEN;
+        g_string_truncate (jar->shared_partial, 0);
+    }
+
+    gchar buf[4096];
+    ssize_t len;
+
+    while ((len = pread (jar->shared_fd, buf, sizeof (buf), jar->shared_offset)) > 0) {
+        jar->shared_offset += len;
+        g_string_append_len (jar->shared_partial, buf, len);
+    }
+
+    if (restart) {
+        jar->shared_compact_at = MAX (UZBL_SHARED_MAX_SIZE, 2 * jar->shared_offset);
+    }
+
+    /* Hand out complete lines only. */
+    gchar *start = jar->shared_partial->str;
+    gchar *end;
+
+    while ((end = strchr (start, '\n'))) {
+        g_ptr_array_add (records, g_strndup (start, end - start));
+        start = end + 1;
+    }
+
+    g_string_erase (jar->shared_partial, 0, start - jar->shared_partial->str);
+
+    return TRUE;
+}
+
+static void
+apply_record (UzblCookieJar *jar, const gchar *record);
+static gchar *
+record_key (const gchar *record);
+
+void
+apply_records (UzblCookieJar *jar, GPtrArray *records, gboolean restarted)
+{
+    /* After a compaction the records start with a snapshot of every live
+     * cookie, which has no records for the cookies deleted before it. Those
+     * are found by tracking which cookies the records leave alive. */
+    GHashTable *live = NULL;
+    time_t now = time (NULL);
+    guint i;
+
+    if (restarted) {
+        live = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    }
+
+    for (i = 0; i < records->len; ++i) {
+        const gchar *record = g_ptr_array_index (records, i);
+
+        apply_record (jar, record);
+
+        gchar *key = live ? record_key (record) : NULL;
+
+        if (!key) {
+            continue;
+        }
+
+        const gchar *expires = strrchr (record, '\t') + 1;
+
+        if ((*record == '+') && (!*expires || (strtol (expires, NULL, 10) > now))) {
+            g_hash_table_add (live, key);
+        } else {
+            g_hash_table_remove (live, key);
+            g_free (key);
+        }
+    }
+
+    if (!live) {
+        return;
+    }
+
+    GSList *cookies = soup_cookie_jar_all_cookies (SOUP_COOKIE_JAR (jar));
+    GSList *iter;
+
+    jar->in_shared_replay = TRUE;
+    for (iter = cookies; iter; iter = iter->next) {
+        SoupCookie *cookie = iter->data;
+        gchar *key = cookie_key (cookie);
+
+        if (!g_hash_table_contains (live, key)) {
+            soup_cookie_jar_delete_cookie (SOUP_COOKIE_JAR (jar), cookie);
+        }
+
+        g_free (key);
+    }
+    jar->in_shared_replay = FALSE;
+
+    g_slist_free_full (cookies, (GDestroyNotify)soup_cookie_free);
+    g_hash_table_destroy (live);
+}
+
+void
+apply_record (UzblCookieJar *jar, const gchar *record)
+{
+    gchar **fields = g_strsplit (record, "\t", 0);
+
+    if ((g_strv_length (fields) != 7) || ((*fields[0] != '+') && (*fields[0] != '-'))) {
+        g_strfreev (fields);
+        return;
+    }
+
+    gchar *domain = g_strcompress (fields[1]);
+    gchar *path = g_strcompress (fields[2]);
+    gchar *name = g_strcompress (fields[3]);
+    gchar *value = g_strcompress (fields[4]);
+    const gchar *flags = fields[5];
+    const gchar *expires = fields[6];
+
+    static const int session_cookie = -1;
+    SoupCookie *cookie = soup_cookie_new (name, value, domain, path, session_cookie);
+
+    soup_cookie_set_secure (cookie, strchr (flags, 's') != NULL);
+    soup_cookie_set_http_only (cookie, strchr (flags, 'h') != NULL);
+    if (*expires) {
+        SoupDate *date = soup_date_new_from_time_t (strtol (expires, NULL, 10));
+        soup_cookie_set_expires (cookie, date);
+        soup_date_free (date);
+    }
+
+    jar->in_shared_replay = TRUE;
+    if (*fields[0] == '+') {
+        /* The jar takes ownership of the cookie. */
+        soup_cookie_jar_add_cookie (SOUP_COOKIE_JAR (jar), cookie);
+    } else {
+        soup_cookie_jar_delete_cookie (SOUP_COOKIE_JAR (jar), cookie);
+        soup_cookie_free (cookie);
+    }
+    jar->in_shared_replay = FALSE;
+
+    g_free (value);
+    g_free (name);
+    g_free (path);
+    g_free (domain);
+    g_strfreev (fields);
+}
+
+void
+compact_journal (UzblCookieJar *jar)
+{
+    GPtrArray *records = g_ptr_array_new_with_free_func (g_free);
+
+    if (!shared_lock (jar, F_WRLCK)) {
+        g_ptr_array_free (records, TRUE);
+        return;
+    }
+
+    /* Catch up with anything written since the last read first. */
+    gboolean restarted = FALSE;
+    gboolean ok = read_journal (jar, records, &restarted);
+
+    apply_records (jar, records, restarted);
+
+    /* Another instance may have compacted it in the meantime. */
+    if (ok && (jar->shared_offset > jar->shared_compact_at)) {
+        GString *snapshot = g_string_new ("");
+        GSList *cookies = soup_cookie_jar_all_cookies (SOUP_COOKIE_JAR (jar));
+        GSList *cookie;
+
+        g_string_append_printf (snapshot, UZBL_SHARED_HEADER, jar->shared_generation + 1);
+        for (cookie = cookies; cookie; cookie = cookie->next) {
+            append_record (snapshot, '+', cookie->data);
+        }
+
+        if (ftruncate (jar->shared_fd, 0) ||
+            (pwrite (jar->shared_fd, snapshot->str, snapshot->len, 0) != (ssize_t)snapshot->len)) {
+            g_warning ("Failed to compact shared cookie file %s: %s\n", jar->shared_path, strerror (errno));
+        } else {
+            ++jar->shared_generation;
+            jar->shared_offset = snapshot->len;
+            jar->shared_compact_at = MAX (UZBL_SHARED_MAX_SIZE, 2 * snapshot->len);
+            g_string_truncate (jar->shared_partial, 0);
+        }
+
+        g_slist_free_full (cookies, (GDestroyNotify)soup_cookie_free);
+        g_string_free (snapshot, TRUE);
+    }
+
+    shared_unlock (jar);
+
+    g_ptr_array_free (records, TRUE);
+}
+
+SoupCookie *
+parse_text_line (gchar *line)
+{
+    gboolean http_only = FALSE;
+
+    if (g_str_has_prefix (line, UZBL_TEXT_HTTP_ONLY)) {
+        line += strlen (UZBL_TEXT_HTTP_ONLY);
+        http_only = TRUE;
+    } else if (*line == '#') {
+        return NULL;
+    }
+
+    /* domain, subdomains, path, secure, expires, name, value */
+    gchar *fields[7];
+    guint i;
+
+    for (i = 0; i < 7; ++i) {
+        fields[i] = line;
+
+        if (i < 6) {
+            if (!(line = strchr (line, '\t'))) {
+                return NULL;
+            }
+            *line++ = '\0';
+        }
+    }
+
+    /* Files written on other systems may have CRLF line endings. */
+    g_strchomp (fields[6]);
+
+    if (!*fields[0] || !*fields[5]) {
+        return NULL;
+    }
+
+    time_t expires = strtol (fields[4], NULL, 10);
+
+    static const int session_cookie = -1;
+    SoupCookie *cookie = soup_cookie_new (fields[5], fields[6], fields[0], fields[2], session_cookie);
+
+    soup_cookie_set_secure (cookie, !g_strcmp0 (fields[3], "TRUE"));
+    soup_cookie_set_http_only (cookie, http_only);
+    if (expires) {
+        SoupDate *date = soup_date_new_from_time_t (expires);
+        soup_cookie_set_expires (cookie, date);
+        soup_date_free (date);
+    }
+
+    return cookie;
+}
+
+void
+append_field (GString *buf, const gchar *field)
+{
+    gchar *escaped = g_strescape (field ? field : "", NULL);
+
+    g_string_append_c (buf, '\t');
+    g_string_append (buf, escaped);
+
+    g_free (escaped);
+}
+
+gchar *
+record_key (const gchar *record)
+{
+    /* The escaped domain, path and name, each with its leading tab. */
+    const gchar *end = record;
+    guint i;
+
+    if ((*record != '+') && (*record != '-')) {
+        return NULL;
+    }
+
+    for (i = 0; end && (i < 4); ++i) {
+        end = strchr (end + 1, '\t');
+    }
+
+    if (!end) {
+        return NULL;
+    }
+
+    return g_strndup (record + 1, end - (record + 1));
+}
+
+gchar *
+cookie_key (SoupCookie *cookie)
+{
+    GString *key = g_string_new ("");
+
+    append_field (key, cookie->domain);
+    append_field (key, cookie->path);
+    append_field (key, cookie->name);
+
+    return g_string_free (key, FALSE);
+}
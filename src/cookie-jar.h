@@ -3,6 +3,8 @@
 
 #include <libsoup/soup-cookie-jar.h>
 
+#include <gio/gio.h>
+
 #define UZBL_TYPE_COOKIE_JAR         (soup_cookie_jar_socket_get_type ())
 #define UZBL_COOKIE_JAR(obj)         (G_TYPE_CHECK_INSTANCE_CAST ((obj), UZBL_TYPE_COOKIE_JAR, UzblCookieJar))
 #define UZBL_COOKIE_JAR_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST ((klass), UZBL_TYPE_COOKIE_JAR,  UzblCookieJarClass))
@@ -11,6 +13,18 @@ typedef struct {
     SoupCookieJar parent;
 
     gboolean in_manual_add;
+
+    /* Journal of changes shared with other instances. */
+    gchar        *shared_path;
+    int           shared_fd;
+    guint         shared_generation;
+    goffset       shared_offset;
+    goffset       shared_compact_at;
+    GString      *shared_partial;
+    GFileMonitor *shared_monitor;
+    gboolean      in_shared_replay;
+    /* Records collected while loading a file, written in one go. */
+    GString      *shared_batch;
 } UzblCookieJar;
 
 typedef struct {
@@ -20,4 +34,19 @@ typedef struct {
 UzblCookieJar *
 uzbl_cookie_jar_new ();
 
+/* Shares cookie changes with every instance using the same path (or stops
+ * sharing if path is NULL or empty). */
+gboolean
+uzbl_cookie_jar_set_shared (UzblCookieJar *jar, const gchar *path);
+
+/* Adds the cookies from a Netscape cookies.txt file without sending events;
+ * rows which have expired delete the cookie they match. Returns the number of
+ * cookies from the file left alive (later rows may delete earlier ones) or -1
+ * on error. */
+gint
+uzbl_cookie_jar_load_text (UzblCookieJar *jar, const gchar *path, GError **error);
+/* Writes every cookie in the jar to a Netscape cookies.txt file. */
+gboolean
+uzbl_cookie_jar_save_text (UzblCookieJar *jar, const gchar *path, GError **error);
+
 #endif
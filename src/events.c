@@ -2,6 +2,7 @@
 
 #include "comm.h"
 #include "io.h"
+#include "stats.h"
 #include "util.h"
 #include "uzbl-core.h"
 
@@ -51,10 +52,19 @@ uzbl_events_send (UzblEventType type, const gchar *custom_event, ...)
 static void
 vuzbl_events_send (UzblEventType type, const gchar *custom_event, va_list vargs)
 {
+    gint64 start = g_get_monotonic_time ();
     const gchar *event_name = custom_event ? custom_event : event_table[type];
     GString *event = uzbl_comm_vformat ("EVENT", event_name, vargs);
 
     uzbl_io_send (event->str, FALSE);
 
+    if (custom_event) {
+        uzbl_stats_record (UZBL_STATS_EVENTS, event_name, start, 0);
+    } else {
+        static UzblStatsEntry *event_stats[LAST_EVENT];
+
+        uzbl_stats_record_cached (&event_stats[type], UZBL_STATS_EVENTS, event_name, start, 0);
+    }
+
     g_string_free (event, TRUE);
 }
@@ -14,6 +14,8 @@
     call (REQUEST_QUEUED),      \
     call (REQUEST_STARTING),    \
     call (REQUEST_FINISHED),    \
+    call (REQUEST_METRICS),     \
+    call (PAGE_METRICS),        \
     call (KEY_PRESS),           \
     call (KEY_RELEASE),         \
     call (MOD_PRESS),           \
@@ -58,6 +60,7 @@
     call (SCRIPT_MESSAGE),      \
     call (SHOW_NOTIFICATION),   \
     call (CLOSE_NOTIFICATION),  \
+    call (STARTUP_TIMELINE),    \
     /* Must be last entry. */   \
     call (LAST_EVENT)
 
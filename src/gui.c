@@ -4,6 +4,7 @@
 #include "events.h"
 #include "io.h"
 #include "menu.h"
+#include "soup.h"
 #include "status-bar.h"
 #include "type.h"
 #include "util.h"
@@ -44,6 +45,10 @@ struct _UzblGui {
 
     GdkEventButton *last_button;
     WebKitWebView *tmp_web_view;
+
+    /* Title updates are deferred while frozen (e.g., during config load). */
+    guint title_freeze_count;
+    gboolean title_update_pending;
 };
 
 /* =========================== PUBLIC API =========================== */
@@ -110,6 +115,11 @@ uzbl_gui_update_title ()
 {
     const gchar *format = NULL;
 
+    if (uzbl.gui_ && uzbl.gui_->title_freeze_count) {
+        uzbl.gui_->title_update_pending = TRUE;
+        return;
+    }
+
     /* Update the status bar if shown. */
     if (uzbl_variables_get_int ("show_status")) {
         format = "title_format_short";
@@ -150,6 +160,33 @@ uzbl_gui_update_title ()
     g_free (title_format);
 }
 
+void
+uzbl_gui_freeze_title ()
+{
+    if (!uzbl.gui_) {
+        return;
+    }
+
+    ++uzbl.gui_->title_freeze_count;
+}
+
+void
+uzbl_gui_thaw_title ()
+{
+    if (!uzbl.gui_ || !uzbl.gui_->title_freeze_count) {
+        return;
+    }
+
+    if (--uzbl.gui_->title_freeze_count) {
+        return;
+    }
+
+    if (uzbl.gui_->title_update_pending) {
+        uzbl.gui_->title_update_pending = FALSE;
+        uzbl_gui_update_title ();
+    }
+}
+
 /* ===================== HELPER IMPLEMENTATIONS ===================== */
 
 static gboolean
@@ -1281,6 +1318,8 @@ send_hover_event (const gchar *uri, const gchar *title)
             NULL);
     }
 
+    uzbl_soup_hover (uzbl.net.soup_session, uri);
+
     uzbl_gui_update_title ();
 }
 
@@ -1381,6 +1420,7 @@ send_load_status (WebKitLoadStatus status, const gchar *uri)
 
     switch (status) {
     case WEBKIT_LOAD_PROVISIONAL:
+        uzbl_soup_page_start ();
         uzbl_events_send (LOAD_START, NULL,
             NULL);
         break;
@@ -1388,7 +1428,8 @@ send_load_status (WebKitLoadStatus status, const gchar *uri)
         /* TODO: Implement. */
         break;
     case WEBKIT_LOAD_FAILED:
-        /* Handled by load_error_cb. */
+        /* Handled by load_error_cb, but the page is over. */
+        uzbl_soup_page_finish (uri);
         break;
     case WEBKIT_LOAD_COMMITTED:
         event = LOAD_COMMIT;
@@ -1406,6 +1447,10 @@ send_load_status (WebKitLoadStatus status, const gchar *uri)
             TYPE_STR, uri ? uri : "",
             NULL);
     }
+
+    if (event == LOAD_FINISH) {
+        uzbl_soup_page_finish (uri);
+    }
 }
 
 gboolean
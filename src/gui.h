@@ -5,6 +5,10 @@
 
 void
 uzbl_gui_update_title ();
+void
+uzbl_gui_freeze_title ();
+void
+uzbl_gui_thaw_title ();
 
 void /* TODO: This should not be public. */
 handle_download (WebKitDownload *download, const gchar *suggested_destination);
@@ -3,6 +3,8 @@
 #include "commands.h"
 #include "events.h"
 #include "setup.h"
+#include "stats.h"
+#include "timeline.h"
 #include "type.h"
 #include "util.h"
 #include "variables.h"
@@ -23,6 +25,11 @@
 
 #include "3p/async-queue-source/rb-async-queue-watch.h"
 
+/* Name of a stream in the statistics (sockets without one are clients). */
+#define UZBL_STREAM_NAME_KEY "uzbl-stream-name"
+/* Where the statistics entry of a stream is kept after its first write. */
+#define UZBL_STREAM_STATS_KEY "uzbl-stream-stats"
+
 struct _UzblIO {
     /* Sockets to connect to as event managers. */
     GPtrArray *connect_sockets;
@@ -127,6 +134,7 @@ uzbl_io_init_stdin ()
     GInputStream *input = g_unix_input_stream_new (STDIN_FILENO, TRUE);
     GOutputStream *output = g_unix_output_stream_new (STDOUT_FILENO, TRUE);
     GIOStream *stream = g_simple_io_stream_new (input, output);
+    g_object_set_data (G_OBJECT (stream), UZBL_STREAM_NAME_KEY, "stdin");
     add_buffered_cmd_source (stream, "Uzbl stdin watcher",
                              control_command_stream, NULL, NULL);
 }
@@ -143,9 +151,11 @@ uzbl_io_init_connect_socket (const gchar *socket_path)
     GSocketAddress *addr = g_unix_socket_address_new (socket_path);
     GSocketClient *client = g_socket_client_new ();
     GSocketConnection *con;
+    guint span = uzbl_timeline_begin ("connect_socket", socket_path);
 
     con = g_socket_client_connect (client, G_SOCKET_CONNECTABLE (addr),
                                    NULL, &error);
+    uzbl_timeline_end (span);
 
     if (!con) {
         g_warning ("Error connecting to socket %s: %s\n", socket_path, error->message);
@@ -154,6 +164,9 @@ uzbl_io_init_connect_socket (const gchar *socket_path)
         return FALSE;
     }
 
+    g_object_set_data_full (G_OBJECT (con), UZBL_STREAM_NAME_KEY,
+        g_strdup (socket_path), g_free);
+
     add_buffered_cmd_source (G_IO_STREAM (con), "Uzbl connect socket",
                              control_command_stream,
                              close_client_socket,
@@ -763,12 +776,14 @@ write_to_stream (GIOStream *stream, const gchar *message)
     GError *error = NULL;
     gboolean success;
     GOutputStream *output = g_io_stream_get_output_stream (stream);
+    gint64 start = g_get_monotonic_time ();
+    gsize len = strlen (message);
 
     if (!output || g_output_stream_is_closed (output)) {
         return;
     }
 
-    success = g_output_stream_write_all (output, message, strlen (message),
+    success = g_output_stream_write_all (output, message, len,
                                          NULL, NULL, &error);
 
     if (! success) {
@@ -779,6 +794,21 @@ write_to_stream (GIOStream *stream, const gchar *message)
             g_warning ("Error flushing: %s", error->message);
             g_clear_error (&error);
         }
+
+        UzblStatsEntry **stats = g_object_get_data (G_OBJECT (stream), UZBL_STREAM_STATS_KEY);
+        const gchar *name = NULL;
+
+        if (!stats) {
+            stats = g_new0 (UzblStatsEntry *, 1);
+            g_object_set_data_full (G_OBJECT (stream), UZBL_STREAM_STATS_KEY, stats, g_free);
+
+            name = g_object_get_data (G_OBJECT (stream), UZBL_STREAM_NAME_KEY);
+            if (!name) {
+                name = "client";
+            }
+        }
+
+        uzbl_stats_record_cached (stats, UZBL_STATS_SOCKETS, name, start, len);
     }
 }
 
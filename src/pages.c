@@ -0,0 +1,428 @@
+#include "pages.h"
+
+#include "scheme.h"
+#include "setup.h"
+#include "uzbl-core.h"
+#include "variables.h"
+
+#include <libsoup/soup.h>
+
+#include <glib/gstdio.h>
+
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Number of entries shown on each page. */
+#define UZBL_PAGES_PAGE_SIZE 100
+
+/* Files are assumed to only be appended to unless they are replaced (as the
+ * example scripts do), so only new lines need to be indexed when they grow. */
+typedef struct {
+    gchar       *path;
+    GMappedFile *file;
+    dev_t        dev;
+    ino_t        ino;
+    /* Offset just past the last complete line which has been indexed. */
+    gsize        indexed;
+    /* Offsets of the start of each non-empty line. */
+    GArray      *lines;
+} UzblPagesIndex;
+
+struct _UzblPages {
+    UzblPagesIndex history;
+    UzblPagesIndex bookmarks;
+};
+
+typedef void (*UzblPagesRender) (GString *buf, const gchar *line, gsize len);
+
+/* =========================== PUBLIC API =========================== */
+
+static void
+index_init (UzblPagesIndex *index);
+static void
+index_clear (UzblPagesIndex *index);
+
+void
+uzbl_pages_init ()
+{
+    uzbl.pages = g_malloc (sizeof (UzblPages));
+
+    index_init (&uzbl.pages->history);
+    index_init (&uzbl.pages->bookmarks);
+
+    uzbl_scheme_add_builtin ("uzbl-history", uzbl_pages_history);
+    uzbl_scheme_add_builtin ("uzbl-bookmarks", uzbl_pages_bookmarks);
+}
+
+void
+uzbl_pages_free ()
+{
+    if (!uzbl.pages) {
+        return;
+    }
+
+    index_clear (&uzbl.pages->history);
+    index_clear (&uzbl.pages->bookmarks);
+    g_array_free (uzbl.pages->history.lines, TRUE);
+    g_array_free (uzbl.pages->bookmarks.lines, TRUE);
+
+    g_free (uzbl.pages);
+    uzbl.pages = NULL;
+}
+
+static void
+render_page (UzblPagesIndex *index, const gchar *variable, const gchar *scheme, const gchar *title,
+             const gchar *uri, UzblPagesRender render, GString *result);
+static void
+render_history (GString *buf, const gchar *line, gsize len);
+static void
+render_bookmark (GString *buf, const gchar *line, gsize len);
+
+void
+uzbl_pages_history (const gchar *uri, GString *result)
+{
+    render_page (&uzbl.pages->history, "history_file", "uzbl-history", "History",
+        uri, render_history, result);
+}
+
+void
+uzbl_pages_bookmarks (const gchar *uri, GString *result)
+{
+    render_page (&uzbl.pages->bookmarks, "bookmarks_file", "uzbl-bookmarks", "Bookmarks",
+        uri, render_bookmark, result);
+}
+
+/* ===================== HELPER IMPLEMENTATIONS ===================== */
+
+void
+index_init (UzblPagesIndex *index)
+{
+    index->path = NULL;
+    index->file = NULL;
+    index->dev = 0;
+    index->ino = 0;
+    index->indexed = 0;
+    index->lines = g_array_new (FALSE, FALSE, sizeof (gsize));
+}
+
+void
+index_clear (UzblPagesIndex *index)
+{
+    if (index->file) {
+        g_mapped_file_unref (index->file);
+        index->file = NULL;
+    }
+
+    g_free (index->path);
+    index->path = NULL;
+    index->indexed = 0;
+    g_array_set_size (index->lines, 0);
+}
+
+static gboolean
+index_refresh (UzblPagesIndex *index, const gchar *path);
+static gboolean
+line_matches (const gchar *line, gsize len, gchar **words);
+static void
+append_escaped (GString *buf, const gchar *str, gsize len);
+static void
+append_link (GString *buf, const gchar *scheme, const gchar *query, guint page, const gchar *label);
+
+void
+render_page (UzblPagesIndex *index, const gchar *variable, const gchar *scheme, const gchar *title,
+             const gchar *uri, UzblPagesRender render, GString *result)
+{
+    SoupURI *soup_uri = soup_uri_new (uri);
+    GHashTable *form = NULL;
+
+    if (soup_uri && soup_uri->query) {
+        form = soup_form_decode (soup_uri->query);
+    }
+
+    const gchar *query = form ? g_hash_table_lookup (form, "q") : NULL;
+    const gchar *page_str = form ? g_hash_table_lookup (form, "page") : NULL;
+    guint page = page_str ? strtoul (page_str, NULL, 10) : 0;
+    gchar **words = g_strsplit_set (query ? query : "", " \t", -1);
+    gchar *path = uzbl_variables_get_string (variable);
+
+    g_string_append (result, "text/html\n"
+        "<!DOCTYPE html>\n"
+        "<html><head><meta charset=\"utf-8\"><title>");
+    g_string_append (result, title);
+    g_string_append (result, "</title></head><body><h1>");
+    g_string_append (result, title);
+    g_string_append_printf (result, "</h1><form action=\"%s:\"><input name=\"q\" value=\"", scheme);
+    if (query) {
+        append_escaped (result, query, strlen (query));
+    }
+    g_string_append (result, "\" autofocus></form>\n");
+
+    if (!*path) {
+        g_string_append_printf (result, "<p><code>%s</code> is not set.</p>\n", variable);
+    } else if (!index_refresh (index, path)) {
+        g_string_append (result, "<p>Failed to read <code>");
+        append_escaped (result, path, strlen (path));
+        g_string_append (result, "</code>.</p>\n");
+    } else {
+        const gchar *data = g_mapped_file_get_contents (index->file);
+        guint skip = page * UZBL_PAGES_PAGE_SIZE;
+        guint shown = 0;
+        gboolean more = FALSE;
+        guint i;
+
+        g_string_append (result, "<ul>\n");
+
+        /* Newest entries first. */
+        for (i = index->lines->len; i--; ) {
+            gsize start = g_array_index (index->lines, gsize, i);
+            const gchar *line = data + start;
+            const gchar *end = memchr (line, '\n', index->indexed - start);
+            gsize len = end - line;
+
+            if (!line_matches (line, len, words)) {
+                continue;
+            }
+
+            if (skip) {
+                --skip;
+                continue;
+            }
+
+            if (shown == UZBL_PAGES_PAGE_SIZE) {
+                more = TRUE;
+                break;
+            }
+
+            render (result, line, len);
+            ++shown;
+        }
+
+        g_string_append (result, "</ul>\n<p>");
+        if (page) {
+            append_link (result, scheme, query, page - 1, "Newer");
+        }
+        if (more) {
+            append_link (result, scheme, query, page + 1, "Older");
+        }
+        g_string_append (result, "</p>\n");
+    }
+
+    g_string_append (result, "</body></html>\n");
+
+    g_free (path);
+    g_strfreev (words);
+    if (form) {
+        g_hash_table_destroy (form);
+    }
+    if (soup_uri) {
+        soup_uri_free (soup_uri);
+    }
+}
+
+void
+render_history (GString *buf, const gchar *line, gsize len)
+{
+    /* YYYY-MM-DD HH:MM:SS URI TITLE */
+    static const gsize date_len = 19;
+
+    if ((len <= date_len) || (line[date_len] != ' ')) {
+        return;
+    }
+
+    const gchar *uri = line + date_len + 1;
+    const gchar *end = line + len;
+    const gchar *title = memchr (uri, ' ', end - uri);
+    gsize uri_len = title ? (gsize)(title - uri) : (gsize)(end - uri);
+
+    if (title) {
+        ++title;
+    }
+
+    g_string_append (buf, "<li><span class=\"date\">");
+    append_escaped (buf, line, date_len);
+    g_string_append (buf, "</span> <a href=\"");
+    append_escaped (buf, uri, uri_len);
+    g_string_append (buf, "\">");
+    if (title && (title < end)) {
+        append_escaped (buf, title, end - title);
+    } else {
+        append_escaped (buf, uri, uri_len);
+    }
+    g_string_append (buf, "</a></li>\n");
+}
+
+void
+render_bookmark (GString *buf, const gchar *line, gsize len)
+{
+    /* URI<TAB>TITLE<TAB>TAGS */
+    const gchar *end = line + len;
+    const gchar *title = memchr (line, '\t', len);
+    const gchar *tags = title ? memchr (title + 1, '\t', end - title - 1) : NULL;
+    gsize uri_len = title ? (gsize)(title - line) : len;
+
+    if (title) {
+        ++title;
+    }
+
+    gsize title_len = title ? (gsize)((tags ? tags : end) - title) : 0;
+
+    g_string_append (buf, "<li><a href=\"");
+    append_escaped (buf, line, uri_len);
+    g_string_append (buf, "\">");
+    if (title_len) {
+        append_escaped (buf, title, title_len);
+    } else {
+        append_escaped (buf, line, uri_len);
+    }
+    g_string_append (buf, "</a>");
+    if (tags && (tags + 1 < end)) {
+        g_string_append (buf, " <span class=\"tags\">");
+        append_escaped (buf, tags + 1, end - tags - 1);
+        g_string_append (buf, "</span>");
+    }
+    g_string_append (buf, "</li>\n");
+}
+
+gboolean
+index_refresh (UzblPagesIndex *index, const gchar *path)
+{
+    GStatBuf st;
+
+    if (g_stat (path, &st)) {
+        index_clear (index);
+        return FALSE;
+    }
+
+    gboolean appended = index->file &&
+                        !g_strcmp0 (index->path, path) &&
+                        (index->dev == st.st_dev) &&
+                        (index->ino == st.st_ino) &&
+                        ((gsize)st.st_size >= index->indexed);
+
+    if (!appended) {
+        index_clear (index);
+        index->path = g_strdup (path);
+        index->dev = st.st_dev;
+        index->ino = st.st_ino;
+    } else if ((gsize)st.st_size == g_mapped_file_get_length (index->file)) {
+        return TRUE;
+    }
+
+    GMappedFile *file = g_mapped_file_new (path, FALSE, NULL);
+
+    if (!file) {
+        index_clear (index);
+        return FALSE;
+    }
+
+    if (index->file) {
+        g_mapped_file_unref (index->file);
+    }
+    index->file = file;
+
+    const gchar *data = g_mapped_file_get_contents (file);
+    const gchar *end = data + g_mapped_file_get_length (file);
+    const gchar *line = data + index->indexed;
+    const gchar *newline;
+
+    /* A trailing partial line is picked up once it is finished. */
+    while ((line < end) && (newline = memchr (line, '\n', end - line))) {
+        if (newline > line) {
+            gsize offset = line - data;
+            g_array_append_val (index->lines, offset);
+        }
+
+        line = newline + 1;
+    }
+
+    index->indexed = line - data;
+
+    return TRUE;
+}
+
+static gboolean
+contains (const gchar *str, gsize len, const gchar *word, gsize word_len);
+
+gboolean
+line_matches (const gchar *line, gsize len, gchar **words)
+{
+    gchar **word;
+
+    for (word = words; *word; ++word) {
+        gsize word_len = strlen (*word);
+
+        if (word_len && !contains (line, len, *word, word_len)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+void
+append_escaped (GString *buf, const gchar *str, gsize len)
+{
+    const gchar *end = str + len;
+
+    for (; str < end; ++str) {
+        switch (*str) {
+        case '&':
+            g_string_append (buf, "&amp;");
+            break;
+        case '<':
+            g_string_append (buf, "&lt;");
+            break;
+        case '>':
+            g_string_append (buf, "&gt;");
+            break;
+        case '"':
+            g_string_append (buf, "&quot;");
+            break;
+        case '\'':
+            g_string_append (buf, "&#39;");
+            break;
+        default:
+            g_string_append_c (buf, *str);
+            break;
+        }
+    }
+}
+
+void
+append_link (GString *buf, const gchar *scheme, const gchar *query, guint page, const gchar *label)
+{
+    gchar *page_str = g_strdup_printf ("%u", page);
+    gchar *form = soup_form_encode (
+        "q", query ? query : "",
+        "page", page_str,
+        NULL);
+
+    g_string_append_printf (buf, "<a href=\"%s:?", scheme);
+    append_escaped (buf, form, strlen (form));
+    g_string_append_printf (buf, "\">%s</a> ", label);
+
+    g_free (form);
+    g_free (page_str);
+}
+
+gboolean
+contains (const gchar *str, gsize len, const gchar *word, gsize word_len)
+{
+    /* Case is only ignored for ASCII, which keeps this a byte comparison. */
+    gchar first = g_ascii_tolower (*word);
+    gsize i;
+
+    if (word_len > len) {
+        return FALSE;
+    }
+
+    for (i = 0; i <= len - word_len; ++i) {
+        if ((g_ascii_tolower (str[i]) == first) &&
+            !g_ascii_strncasecmp (str + i + 1, word + 1, word_len - 1)) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
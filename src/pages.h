@@ -0,0 +1,13 @@
+#ifndef UZBL_PAGES_H
+#define UZBL_PAGES_H
+
+#include <glib.h>
+
+/* Builtin scheme handlers for uzbl-history: and uzbl-bookmarks: URIs. The
+ * query may contain q (words to search for) and page (counted from 0). */
+void
+uzbl_pages_history (const gchar *uri, GString *result);
+void
+uzbl_pages_bookmarks (const gchar *uri, GString *result);
+
+#endif
@@ -0,0 +1,109 @@
+#include "property-cache.h"
+
+#include "util.h"
+
+#include <gobject/gvaluecollector.h>
+
+/* =========================== PUBLIC API =========================== */
+
+static const GValue *
+property_cache_lookup (GObject *obj, const gchar *prop);
+
+void
+uzbl_property_cache_get (GObject *obj, const gchar *prop, ...)
+{
+    const GValue *value = property_cache_lookup (obj, prop);
+
+    if (!value) {
+        return;
+    }
+
+    va_list args;
+    gchar *error = NULL;
+
+    va_start (args, prop);
+    G_VALUE_LCOPY (value, args, 0, &error);
+    va_end (args);
+
+    if (error) {
+        g_warning ("Failed to read property %s: %s", prop, error);
+        g_free (error);
+    }
+}
+
+/* ===================== HELPER IMPLEMENTATIONS ===================== */
+
+static GQuark
+property_cache_quark ();
+static void
+property_cache_invalidate (GObject *obj, GParamSpec *pspec, gpointer data);
+static void
+property_value_free (gpointer data);
+
+const GValue *
+property_cache_lookup (GObject *obj, const gchar *prop)
+{
+    g_return_val_if_fail (G_IS_OBJECT (obj), NULL);
+
+    /* Callers may spell the name with underscores, but notify always uses
+     * the canonical name, so that is the key. */
+    GParamSpec *pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (obj), prop);
+
+    if (!pspec) {
+        g_warning ("%s has no property named %s", G_OBJECT_TYPE_NAME (obj), prop);
+        return NULL;
+    }
+
+    const gchar *name = g_param_spec_get_name (pspec);
+    GHashTable *cache = (GHashTable *)g_object_get_qdata (obj, property_cache_quark ());
+
+    if (!cache) {
+        /* The names belong to the class, which outlives the object. */
+        cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+            NULL, property_value_free);
+
+        g_object_set_qdata_full (obj, property_cache_quark (),
+            cache, (GDestroyNotify)g_hash_table_destroy);
+        g_signal_connect (obj, "notify",
+            G_CALLBACK (property_cache_invalidate), cache);
+    }
+
+    GValue *value = (GValue *)g_hash_table_lookup (cache, name);
+
+    if (value) {
+        return value;
+    }
+
+    value = g_malloc0 (sizeof (GValue));
+    g_value_init (value, G_PARAM_SPEC_VALUE_TYPE (pspec));
+    g_object_get_property (obj, name, value);
+
+    g_hash_table_insert (cache, (gpointer)name, value);
+
+    return value;
+}
+
+GQuark
+property_cache_quark ()
+{
+    return g_quark_from_static_string ("uzbl-property-cache");
+}
+
+void
+property_cache_invalidate (GObject *obj, GParamSpec *pspec, gpointer data)
+{
+    UZBL_UNUSED (obj);
+
+    GHashTable *cache = (GHashTable *)data;
+
+    g_hash_table_remove (cache, g_param_spec_get_name (pspec));
+}
+
+void
+property_value_free (gpointer data)
+{
+    GValue *value = (GValue *)data;
+
+    g_value_unset (value);
+    g_free (value);
+}
@@ -0,0 +1,13 @@
+#ifndef UZBL_PROPERTY_CACHE_H
+#define UZBL_PROPERTY_CACHE_H
+
+#include <glib-object.h>
+
+/* Reads a property like g_object_get (for a single property). Values are
+ * cached per object and dropped whenever the object emits a notify signal
+ * for them, so reading a variable (e.g., when dumping the config) does not
+ * have to go through g_object_get each time. */
+void
+uzbl_property_cache_get (GObject *obj, const gchar *prop, ...);
+
+#endif
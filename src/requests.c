@@ -2,6 +2,7 @@
 
 #include "comm.h"
 #include "io.h"
+#include "stats.h"
 #include "type.h"
 #include "util.h"
 #include "uzbl-core.h"
@@ -94,9 +95,12 @@ vuzbl_requests_send (gint64 timeout, const gchar *request, const gchar *cookie,
     GString *request_id = g_string_new ("");
     g_string_printf (request_id, "REQUEST-%s", cookie);
 
+    gint64 start = g_get_monotonic_time ();
     GString *rq = uzbl_comm_vformat (request_id->str, request, vargs);
     GString *result = send_request_sockets (timeout, rq, cookie);
 
+    uzbl_stats_record (UZBL_STATS_REQUESTS, request, start, 0);
+
     g_string_free (request_id, TRUE);
     g_string_free (rq, TRUE);
 
@@ -108,7 +112,7 @@ send_request_sockets (gint64 timeout, GString *msg, const gchar *cookie)
 {
     uzbl_io_send (msg->str, TRUE);
 
-    /* Require replies within 1 second. */
+    /* Require replies within timeout seconds, unless it is not positive. */
     gint64 deadline = g_get_monotonic_time () + timeout * G_TIME_SPAN_SECOND;
 
     GString *reply_cookie = g_string_new ("");
@@ -118,13 +122,13 @@ send_request_sockets (gint64 timeout, GString *msg, const gchar *cookie)
 
     gboolean done = FALSE;
     do {
-        gboolean timeout = FALSE;
+        gboolean timed_out = FALSE;
 
         g_mutex_lock (&uzbl.requests->reply_lock);
         while (!uzbl.requests->reply) {
             if (timeout > 0) {
                 if (!g_cond_wait_until (&uzbl.requests->reply_cond, &uzbl.requests->reply_lock, deadline)) {
-                    timeout = TRUE;
+                    timed_out = TRUE;
                     break;
                 }
             } else {
@@ -132,7 +136,7 @@ send_request_sockets (gint64 timeout, GString *msg, const gchar *cookie)
             }
         }
 
-        if (timeout) {
+        if (timed_out) {
             done = TRUE;
         } else if (g_str_has_prefix (uzbl.requests->reply, reply_cookie->str)) {
             g_string_assign (req_result, uzbl.requests->reply + reply_cookie->len);
@@ -29,6 +29,19 @@ uzbl_scheme_request_add_handler (const gchar *scheme, const gchar *command)
     request_class->schemes = (const char **)uzbl_scheme_request_class->schemes->data;
 }
 
+void
+uzbl_scheme_request_add_builtin (const gchar *scheme, UzblSchemeBuiltin handler)
+{
+    UzblSchemeRequestClass *uzbl_scheme_request_class = g_type_class_ref (UZBL_TYPE_SCHEME_REQUEST);
+    SoupRequestClass *request_class = SOUP_REQUEST_CLASS (uzbl_scheme_request_class);
+
+    char *scheme_dup = g_strdup (scheme);
+    g_hash_table_insert (uzbl_scheme_request_class->builtins,
+        scheme_dup, handler);
+    g_array_append_val (uzbl_scheme_request_class->schemes, scheme_dup);
+    request_class->schemes = (const char **)uzbl_scheme_request_class->schemes->data;
+}
+
 /* ===================== HELPER IMPLEMENTATIONS ===================== */
 
 static void
@@ -38,6 +51,10 @@ static gboolean
 uzbl_scheme_request_check_uri (SoupRequest *request, SoupURI *uri, GError **error);
 static GInputStream *
 uzbl_scheme_request_send (SoupRequest *request, GCancellable *cancellable, GError **error);
+static void
+uzbl_scheme_request_send_async (SoupRequest *request, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer data);
+static GInputStream *
+uzbl_scheme_request_send_finish (SoupRequest *request, GAsyncResult *result, GError **error);
 static goffset
 uzbl_scheme_request_get_content_length (SoupRequest *request);
 static const char *
@@ -65,12 +82,15 @@ uzbl_scheme_request_class_init (UzblSchemeRequestClass *uzbl_scheme_request_clas
 
     uzbl_scheme_request_class->schemes = g_array_new (TRUE, TRUE, sizeof (gchar *));
     uzbl_scheme_request_class->handlers = g_hash_table_new (g_str_hash, g_str_equal);
+    uzbl_scheme_request_class->builtins = g_hash_table_new (g_str_hash, g_str_equal);
 
     gobject_class->finalize = uzbl_scheme_request_finalize;
 
     scheme_request_class->schemes = (const char **)uzbl_scheme_request_class->schemes->data;
     scheme_request_class->check_uri = uzbl_scheme_request_check_uri;
     scheme_request_class->send = uzbl_scheme_request_send;
+    scheme_request_class->send_async = uzbl_scheme_request_send_async;
+    scheme_request_class->send_finish = uzbl_scheme_request_send_finish;
     scheme_request_class->get_content_length = uzbl_scheme_request_get_content_length;
     scheme_request_class->get_content_type = uzbl_scheme_request_get_content_type;
 
@@ -80,6 +100,10 @@ uzbl_scheme_request_class_init (UzblSchemeRequestClass *uzbl_scheme_request_clas
 void
 uzbl_scheme_request_finalize (GObject *obj)
 {
+    UzblSchemeRequest *uzbl_request = UZBL_SCHEME_REQUEST (obj);
+
+    g_free (uzbl_request->priv->content_type);
+
     G_OBJECT_CLASS (uzbl_scheme_request_parent_class)->finalize (obj);
 }
 
@@ -93,54 +117,244 @@ uzbl_scheme_request_check_uri (SoupRequest *request, SoupURI *uri, GError **erro
     return TRUE;
 }
 
+static GInputStream *
+run_handler (UzblSchemeRequest *request, GString **result, GError **error);
+static GInputStream *
+send_stream (UzblSchemeRequest *request, GInputStream *output, GCancellable *cancellable, GError **error);
+static GInputStream *
+send_result (UzblSchemeRequest *request, GString *result, GCancellable *cancellable, GError **error);
+
 GInputStream *
 uzbl_scheme_request_send (SoupRequest *request, GCancellable *cancellable, GError **error)
 {
-    UZBL_UNUSED (cancellable);
-    UZBL_UNUSED (error);
+    UzblSchemeRequest *uzbl_request = UZBL_SCHEME_REQUEST (request);
+    GString *result = NULL;
+    GInputStream *output = run_handler (uzbl_request, &result, error);
+
+    if (output) {
+        return send_stream (uzbl_request, output, cancellable, error);
+    }
+
+    if (!result) {
+        return NULL;
+    }
+
+    return send_result (uzbl_request, result, cancellable, error);
+}
+
+static void
+send_stream_thread (GTask *task, gpointer source, gpointer data, GCancellable *cancellable);
 
+void
+uzbl_scheme_request_send_async (SoupRequest *request, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer data)
+{
     UzblSchemeRequest *uzbl_request = UZBL_SCHEME_REQUEST (request);
-    UzblSchemeRequestClass *cls = UZBL_SCHEME_REQUEST_GET_CLASS (uzbl_request);
+    GTask *task = g_task_new (request, cancellable, callback, data);
+    GError *error = NULL;
+    GString *result = NULL;
+
+    /* Commands have to run in the main thread, but spawned handlers only
+     * need to be waited for, which is done in a worker thread so that
+     * several requests can be waiting at once. */
+    GInputStream *output = run_handler (uzbl_request, &result, &error);
+
+    if (output) {
+        g_task_set_task_data (task, output, g_object_unref);
+        g_task_run_in_thread (task, send_stream_thread);
+    } else if (result) {
+        GInputStream *stream = send_result (uzbl_request, result, cancellable, &error);
+
+        if (stream) {
+            g_task_return_pointer (task, stream, g_object_unref);
+        } else {
+            g_task_return_error (task, error);
+        }
+    } else {
+        g_task_return_error (task, error);
+    }
+
+    g_object_unref (task);
+}
+
+GInputStream *
+uzbl_scheme_request_send_finish (SoupRequest *request, GAsyncResult *result, GError **error)
+{
+    UZBL_UNUSED (request);
 
-    SoupURI *uri = soup_request_get_uri (request);
+    return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+goffset
+uzbl_scheme_request_get_content_length (SoupRequest *request)
+{
+    UzblSchemeRequest *uzbl_request = UZBL_SCHEME_REQUEST (request);
+
+    return uzbl_request->priv->content_length;
+}
+
+const char *
+uzbl_scheme_request_get_content_type (SoupRequest *request)
+{
+    UzblSchemeRequest *uzbl_request = UZBL_SCHEME_REQUEST (request);
+
+    return uzbl_request->priv->content_type ? uzbl_request->priv->content_type : "text/html";
+}
+
+GInputStream *
+run_handler (UzblSchemeRequest *request, GString **result, GError **error)
+{
+    UzblSchemeRequestClass *cls = UZBL_SCHEME_REQUEST_GET_CLASS (request);
+
+    SoupURI *uri = soup_request_get_uri (SOUP_REQUEST (request));
     const char *command = g_hash_table_lookup (cls->handlers, uri->scheme);
+    UzblSchemeBuiltin builtin = g_hash_table_lookup (cls->builtins, uri->scheme);
+
+    if (!command && builtin) {
+        gchar *uri_str = soup_uri_to_string (uri, FALSE);
+
+        *result = g_string_new ("");
+        builtin (uri_str, *result);
+
+        g_free (uri_str);
+        return NULL;
+    }
 
-    GString *result = g_string_new ("");
     GArray *args = uzbl_commands_args_new ();
     const UzblCommand *cmd = uzbl_commands_parse (command, args);
+    GInputStream *output = NULL;
+    GError *err = NULL;
+
+    *result = NULL;
 
     if (cmd) {
         uzbl_commands_args_append (args, soup_uri_to_string (uri, TRUE));
-        uzbl_commands_run_parsed (cmd, args, result);
+
+        /* Spawned handlers are read as they write rather than once they
+         * exit. */
+        output = uzbl_commands_run_stream (cmd, args, &err);
+    }
+
+    if (err) {
+        g_propagate_error (error, err);
+    } else if (!output) {
+        *result = g_string_new ("");
+        uzbl_commands_run_parsed (cmd, args, *result);
     }
 
     uzbl_commands_args_free (args);
 
+    return output;
+}
+
+static GInputStream *
+send_file (UzblSchemeRequest *request, const gchar *uri, GCancellable *cancellable, GError **error);
+
+GInputStream *
+send_stream (UzblSchemeRequest *request, GInputStream *output, GCancellable *cancellable, GError **error)
+{
+    GDataInputStream *data = g_data_input_stream_new (output);
+    g_object_unref (output);
+
+    g_data_input_stream_set_newline_type (data, G_DATA_STREAM_NEWLINE_TYPE_LF);
+
+    /* Only the content type line is waited for; the rest of the output is
+     * passed on as the handler writes it. */
+    gchar *line = g_data_input_stream_read_line (data, NULL, cancellable, error);
+
+    if (!line) {
+        if (error && *error) {
+            g_object_unref (data);
+            return NULL;
+        }
+
+        line = g_strdup ("");
+    }
+
+    if (g_str_has_prefix (line, "file://")) {
+        GInputStream *stream = send_file (request, line, cancellable, error);
+
+        g_free (line);
+        g_object_unref (data);
+
+        return stream;
+    }
+
+    request->priv->content_length = -1;
+    request->priv->content_type = line;
+
+    return G_INPUT_STREAM (data);
+}
+
+GInputStream *
+send_result (UzblSchemeRequest *request, GString *result, GCancellable *cancellable, GError **error)
+{
     gchar *end = strchr (result->str, '\n');
     size_t line_len = end ? (size_t)(end - result->str) : result->len;
 
-    uzbl_request->priv->content_length = result->len - line_len - 1;
-    uzbl_request->priv->content_type = g_strndup (result->str, line_len);
-    GInputStream *stream = g_memory_input_stream_new_from_data (
-        g_strdup (end + 1),
-        uzbl_request->priv->content_length, g_free);
-    g_string_free (result, TRUE);
+    if (g_str_has_prefix (result->str, "file://")) {
+        gchar *file_uri = g_strndup (result->str, line_len);
+        GInputStream *stream = send_file (request, file_uri, cancellable, error);
+
+        g_free (file_uri);
+        g_string_free (result, TRUE);
+
+        return stream;
+    }
+
+    request->priv->content_length = end ? (result->len - line_len - 1) : 0;
+    request->priv->content_type = g_strndup (result->str, line_len);
+
+    /* Hand the buffer over rather than copying the body out of it. */
+    gsize offset = end ? (line_len + 1) : result->len;
+    gchar *data = g_string_free (result, FALSE);
+    GBytes *bytes = g_bytes_new_take (data, offset + request->priv->content_length);
+    GBytes *body = g_bytes_new_from_bytes (bytes, offset, request->priv->content_length);
+    GInputStream *stream = g_memory_input_stream_new_from_bytes (body);
+
+    g_bytes_unref (body);
+    g_bytes_unref (bytes);
 
     return stream;
 }
 
-goffset
-uzbl_scheme_request_get_content_length (SoupRequest *request)
+void
+send_stream_thread (GTask *task, gpointer source, gpointer data, GCancellable *cancellable)
 {
-    UzblSchemeRequest *uzbl_request = UZBL_SCHEME_REQUEST (request);
-
-    return uzbl_request->priv->content_length;
+    GError *error = NULL;
+    /* send_stream takes the reference. */
+    GInputStream *output = g_object_ref (data);
+    GInputStream *stream = send_stream (UZBL_SCHEME_REQUEST (source), output, cancellable, &error);
+
+    if (stream) {
+        g_task_return_pointer (task, stream, g_object_unref);
+    } else {
+        g_task_return_error (task, error);
+    }
 }
 
-const char *
-uzbl_scheme_request_get_content_type (SoupRequest *request)
+GInputStream *
+send_file (UzblSchemeRequest *request, const gchar *uri, GCancellable *cancellable, GError **error)
 {
-    UzblSchemeRequest *uzbl_request = UZBL_SCHEME_REQUEST (request);
+    GFile *file = g_file_new_for_uri (uri);
+    GFileInputStream *stream = g_file_read (file, cancellable, error);
+
+    if (stream) {
+        GFileInfo *info = g_file_input_stream_query_info (stream,
+            G_FILE_ATTRIBUTE_STANDARD_SIZE, cancellable, NULL);
+        gchar *path = g_file_get_path (file);
+        gchar *content_type = g_content_type_guess (path, NULL, 0, NULL);
+
+        request->priv->content_length = info ? g_file_info_get_size (info) : -1;
+        request->priv->content_type = g_content_type_get_mime_type (content_type);
+
+        g_free (content_type);
+        g_free (path);
+        if (info) {
+            g_object_unref (info);
+        }
+    }
 
-    return uzbl_request->priv->content_type ? uzbl_request->priv->content_type : "text/html";
+    g_object_unref (file);
+
+    return G_INPUT_STREAM (stream);
 }
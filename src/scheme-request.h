@@ -32,12 +32,20 @@ typedef struct {
     SoupRequestClass parent;
     GArray *schemes;
     GHashTable *handlers;
+    GHashTable *builtins;
 } UzblSchemeRequestClass;
 
+/* Builtin handlers write the response (a line with the MIME type followed by
+ * the content) for uri to result. They are called in the main thread. */
+typedef void (*UzblSchemeBuiltin) (const gchar *uri, GString *result);
+
 GType
 uzbl_scheme_request_get_type ();
 
 void
 uzbl_scheme_request_add_handler (const gchar *scheme, const gchar *command);
+/* Handlers added with uzbl_scheme_request_add_handler take precedence. */
+void
+uzbl_scheme_request_add_builtin (const gchar *scheme, UzblSchemeBuiltin handler);
 
 #endif
@@ -18,3 +18,9 @@ uzbl_scheme_add_handler (const gchar *scheme, const gchar *command)
 {
     uzbl_scheme_request_add_handler (scheme, command);
 }
+
+void
+uzbl_scheme_add_builtin (const gchar *scheme, void (*handler) (const gchar *uri, GString *result))
+{
+    uzbl_scheme_request_add_builtin (scheme, handler);
+}
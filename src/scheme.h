@@ -5,5 +5,9 @@
 
 void
 uzbl_scheme_add_handler (const gchar *scheme, const gchar *command);
+/* Registers a handler implemented in uzbl which writes the MIME type line and
+ * content for a URI to result. */
+void
+uzbl_scheme_add_builtin (const gchar *scheme, void (*handler) (const gchar *uri, GString *result));
 
 #endif
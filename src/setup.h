@@ -41,6 +41,11 @@ uzbl_io_quit ();
 void
 uzbl_js_init ();
 
+void
+uzbl_pages_init ();
+void
+uzbl_pages_free ();
+
 void
 uzbl_requests_init ();
 void
@@ -52,6 +57,18 @@ uzbl_requests_set_reply (const gchar *reply);
 void
 uzbl_scheme_init ();
 
+void
+uzbl_stats_init ();
+void
+uzbl_stats_free ();
+
+void
+uzbl_timeline_init (gint64 origin, const gchar *path);
+void
+uzbl_timeline_free ();
+void
+uzbl_timeline_finish ();
+
 void
 uzbl_variables_init ();
 void
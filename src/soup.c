@@ -1,5 +1,6 @@
 #include "soup.h"
 
+#include "comm.h"
 #include "commands.h"
 #include "cookie-jar.h"
 #include "events.h"
@@ -9,6 +10,65 @@
 #include "uzbl-core.h"
 #include "variables.h"
 
+#include <libsoup/soup-cache.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/* How often to check whether another instance released the cache. */
+#define UZBL_DISK_CACHE_RETRY (10 * G_TIME_SPAN_SECOND)
+/* Requests for a preconnected host within this long count as hits. */
+#define UZBL_PRECONNECT_WINDOW (30 * G_TIME_SPAN_SECOND)
+
+struct _UzblDiskCache {
+    gchar     *dir;
+    guint      max_size;
+
+    /* The cache is only attached while the lock is held. */
+    SoupCache *cache;
+    int        lock_fd;
+    gint64     next_attempt;
+
+    guint      hits;
+    guint      validations;
+    guint      misses;
+};
+
+struct _UzblPreconnect {
+    guint        delay;
+    gchar       *hover_uri;
+    guint        hover_id;
+
+    /* Hosts looked up recently, mapped to when. */
+    GHashTable  *hosts;
+    guint        in_flight;
+
+    guint        count;
+    guint        hits;
+};
+
+/* Monotonic times of a request's milestones (0 if not reached). */
+typedef struct {
+    gint64 queued;
+    gint64 started;
+    gint64 headers;
+    gsize  bytes;
+} UzblRequestMetrics;
+
+struct _UzblPageMetrics {
+    gboolean  active;
+    gint64    start;
+
+    guint     requests;
+    guint     cached;
+    gsize     bytes;
+    gint64    last_finished;
+    /* JSON objects of the requests, without the surrounding brackets. */
+    GString  *entries;
+};
+
 static void
 request_queued_cb (SoupSession *session,
                    SoupMessage *msg,
@@ -37,6 +97,16 @@ uzbl_soup_init (SoupSession *session)
 
     uzbl.net.soup_cookie_jar = uzbl_cookie_jar_new ();
 
+    uzbl.net.disk_cache = g_malloc0 (sizeof (UzblDiskCache));
+    uzbl.net.disk_cache->lock_fd = -1;
+
+    uzbl.net.preconnect = g_malloc0 (sizeof (UzblPreconnect));
+    uzbl.net.preconnect->hosts = g_hash_table_new_full (g_str_hash, g_str_equal,
+        g_free, g_free);
+
+    uzbl.net.page_metrics = g_malloc0 (sizeof (UzblPageMetrics));
+    uzbl.net.page_metrics->entries = g_string_new ("");
+
     soup_session_add_feature (session,
         SOUP_SESSION_FEATURE (uzbl.net.soup_cookie_jar));
 
@@ -47,6 +117,38 @@ uzbl_soup_init (SoupSession *session)
         NULL);
 }
 
+static void
+disk_cache_detach (SoupSession *session);
+
+void
+uzbl_soup_free (SoupSession *session)
+{
+    if (!uzbl.net.disk_cache) {
+        return;
+    }
+
+    disk_cache_detach (session);
+    g_free (uzbl.net.disk_cache->dir);
+
+    g_free (uzbl.net.disk_cache);
+    uzbl.net.disk_cache = NULL;
+
+    UzblPreconnect *preconnect = uzbl.net.preconnect;
+
+    if (preconnect->hover_id) {
+        g_source_remove (preconnect->hover_id);
+    }
+    g_free (preconnect->hover_uri);
+    g_hash_table_destroy (preconnect->hosts);
+
+    g_free (preconnect);
+    uzbl.net.preconnect = NULL;
+
+    g_string_free (uzbl.net.page_metrics->entries, TRUE);
+    g_free (uzbl.net.page_metrics);
+    uzbl.net.page_metrics = NULL;
+}
+
 void
 uzbl_soup_disable_builtin_auth (SoupSession *session) {
     g_signal_handler_block ((gpointer) session, uzbl.net.builtin_auth_id);
@@ -57,14 +159,334 @@ uzbl_soup_enable_builtin_auth (SoupSession *session) {
     g_signal_handler_unblock ((gpointer) session, uzbl.net.builtin_auth_id);
 }
 
+static gboolean
+disk_cache_attach (SoupSession *session);
+
+void
+uzbl_soup_set_disk_cache_dir (SoupSession *session, const gchar *dir)
+{
+    UzblDiskCache *disk_cache = uzbl.net.disk_cache;
+
+    disk_cache_detach (session);
+
+    g_free (disk_cache->dir);
+    disk_cache->dir = (dir && *dir) ? g_strdup (dir) : NULL;
+    disk_cache->next_attempt = 0;
+
+    if (disk_cache->dir) {
+        disk_cache_attach (session);
+    }
+}
+
+const gchar *
+uzbl_soup_get_disk_cache_dir ()
+{
+    return uzbl.net.disk_cache->dir;
+}
+
+void
+uzbl_soup_set_disk_cache_size (guint size)
+{
+    UzblDiskCache *disk_cache = uzbl.net.disk_cache;
+
+    disk_cache->max_size = size;
+
+    if (disk_cache->cache && size) {
+        soup_cache_set_max_size (disk_cache->cache, size);
+    }
+}
+
+guint
+uzbl_soup_get_disk_cache_size ()
+{
+    UzblDiskCache *disk_cache = uzbl.net.disk_cache;
+
+    if (disk_cache->cache) {
+        return soup_cache_get_max_size (disk_cache->cache);
+    }
+
+    return disk_cache->max_size;
+}
+
+guint
+uzbl_soup_get_disk_cache_hits ()
+{
+    return uzbl.net.disk_cache->hits;
+}
+
+guint
+uzbl_soup_get_disk_cache_validations ()
+{
+    return uzbl.net.disk_cache->validations;
+}
+
+guint
+uzbl_soup_get_disk_cache_misses ()
+{
+    return uzbl.net.disk_cache->misses;
+}
+
+static void
+prune_preconnected (gint64 now);
+#ifdef HAVE_LIBSOUP_CHECK_VERSION
+static void
+prefetch_done_cb (SoupAddress *address, guint status, gpointer data);
+#endif
+
+void
+uzbl_soup_preconnect (SoupSession *session, const gchar *uri)
+{
+    UzblPreconnect *preconnect = uzbl.net.preconnect;
+    SoupURI *soup_uri = soup_uri_new (uri);
+
+    if (!soup_uri) {
+        return;
+    }
+
+    if (!soup_uri->host || !SOUP_URI_VALID_FOR_HTTP (soup_uri)) {
+        soup_uri_free (soup_uri);
+        return;
+    }
+
+    gint64 now = g_get_monotonic_time ();
+    int max_conns_host = 0;
+
+    g_object_get (G_OBJECT (session),
+        SOUP_SESSION_MAX_CONNS_PER_HOST, &max_conns_host,
+        NULL);
+
+    prune_preconnected (now);
+
+    /* Hosts are only looked up once per window. */
+    if (!g_hash_table_contains (preconnect->hosts, soup_uri->host) &&
+        (preconnect->in_flight < (guint)MAX (max_conns_host, 1))) {
+        gint64 *when = g_malloc (sizeof (gint64));
+
+        *when = now;
+        g_hash_table_insert (preconnect->hosts, g_strdup (soup_uri->host), when);
+        ++preconnect->count;
+
+#ifdef HAVE_LIBSOUP_CHECK_VERSION
+        ++preconnect->in_flight;
+        soup_session_prefetch_dns (session, soup_uri->host, NULL,
+            prefetch_done_cb, NULL);
+#else
+        soup_session_prepare_for_uri (session, soup_uri);
+#endif
+    }
+
+    soup_uri_free (soup_uri);
+}
+
+static gboolean
+hover_timeout_cb (gpointer data);
+
+void
+uzbl_soup_hover (SoupSession *session, const gchar *uri)
+{
+    UzblPreconnect *preconnect = uzbl.net.preconnect;
+
+    if (preconnect->hover_id) {
+        g_source_remove (preconnect->hover_id);
+        preconnect->hover_id = 0;
+    }
+
+    g_free (preconnect->hover_uri);
+    preconnect->hover_uri = NULL;
+
+    if (!uri || !preconnect->delay) {
+        return;
+    }
+
+    preconnect->hover_uri = g_strdup (uri);
+    preconnect->hover_id = g_timeout_add (preconnect->delay, hover_timeout_cb, session);
+}
+
+void
+uzbl_soup_set_preconnect_delay (guint delay)
+{
+    uzbl.net.preconnect->delay = delay;
+}
+
+guint
+uzbl_soup_get_preconnect_delay ()
+{
+    return uzbl.net.preconnect->delay;
+}
+
+guint
+uzbl_soup_get_preconnect_count ()
+{
+    return uzbl.net.preconnect->count;
+}
+
+guint
+uzbl_soup_get_preconnect_hits ()
+{
+    return uzbl.net.preconnect->hits;
+}
+
+void
+uzbl_soup_page_start ()
+{
+    UzblPageMetrics *page = uzbl.net.page_metrics;
+
+    page->active = TRUE;
+    page->start = g_get_monotonic_time ();
+    page->requests = 0;
+    page->cached = 0;
+    page->bytes = 0;
+    page->last_finished = page->start;
+    g_string_truncate (page->entries, 0);
+}
+
+void
+uzbl_soup_page_finish (const gchar *uri)
+{
+    UzblPageMetrics *page = uzbl.net.page_metrics;
+
+    if (!page->active) {
+        return;
+    }
+
+    page->active = FALSE;
+
+    GString *json = g_string_new ("");
+
+    g_string_append_printf (json,
+        "{\"requests\":%u,\"cached\":%u,\"bytes\":%" G_GSIZE_FORMAT ",\"duration_us\":%" G_GINT64_FORMAT ",\"entries\":[%s]}",
+        page->requests, page->cached, page->bytes,
+        page->last_finished - page->start,
+        page->entries->str);
+
+    uzbl_events_send (PAGE_METRICS, NULL,
+        TYPE_STR, uri ? uri : "",
+        TYPE_STR, json->str,
+        NULL);
+
+    g_string_free (json, TRUE);
+    g_string_truncate (page->entries, 0);
+}
+
+gboolean
+disk_cache_attach (SoupSession *session)
+{
+    UzblDiskCache *disk_cache = uzbl.net.disk_cache;
+
+    disk_cache->next_attempt = g_get_monotonic_time () + UZBL_DISK_CACHE_RETRY;
+
+    if (g_mkdir_with_parents (disk_cache->dir, 0700)) {
+        g_warning ("Failed to create cache directory %s: %s\n", disk_cache->dir, strerror (errno));
+        return FALSE;
+    }
+
+    gchar *lock_path = g_build_filename (disk_cache->dir, "uzbl.lock", NULL);
+    int fd = open (lock_path, O_RDWR | O_CREAT, 0600);
+
+    if (fd < 0) {
+        g_warning ("Failed to open cache lock %s: %s\n", lock_path, strerror (errno));
+        g_free (lock_path);
+        return FALSE;
+    }
+
+    g_free (lock_path);
+
+    /* POSIX record locks are dropped when the process exits and are not
+     * inherited by spawned children. */
+    struct flock lock;
+
+    memset (&lock, 0, sizeof (lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+
+    if (fcntl (fd, F_SETLK, &lock)) {
+        uzbl_debug ("Cache directory %s is in use by another instance\n", disk_cache->dir);
+        close (fd);
+        return FALSE;
+    }
+
+    fcntl (fd, F_SETFD, FD_CLOEXEC);
+    disk_cache->lock_fd = fd;
+
+    disk_cache->cache = soup_cache_new (disk_cache->dir, SOUP_CACHE_SINGLE_USER);
+    if (disk_cache->max_size) {
+        soup_cache_set_max_size (disk_cache->cache, disk_cache->max_size);
+    }
+    soup_cache_load (disk_cache->cache);
+
+    soup_session_add_feature (session,
+        SOUP_SESSION_FEATURE (disk_cache->cache));
+
+    return TRUE;
+}
+
+void
+disk_cache_detach (SoupSession *session)
+{
+    UzblDiskCache *disk_cache = uzbl.net.disk_cache;
+
+    if (!disk_cache->cache) {
+        return;
+    }
+
+    soup_session_remove_feature (session,
+        SOUP_SESSION_FEATURE (disk_cache->cache));
+
+    /* Write out pending entries and the index before giving up the lock. */
+    soup_cache_flush (disk_cache->cache);
+    soup_cache_dump (disk_cache->cache);
+
+    g_object_unref (disk_cache->cache);
+    disk_cache->cache = NULL;
+
+    close (disk_cache->lock_fd);
+    disk_cache->lock_fd = -1;
+}
+
+static void
+cache_finished_cb (SoupMessage *msg, gpointer data);
+static void
+metrics_headers_cb (SoupMessage *msg, gpointer data);
+static void
+metrics_chunk_cb (SoupMessage *msg, SoupBuffer *chunk, gpointer data);
+static void
+metrics_finished_cb (SoupMessage *msg, gpointer data);
+
+#define UZBL_METRICS_KEY "uzbl-metrics"
+
 void
 request_queued_cb (SoupSession *session,
                    SoupMessage *msg,
                    gpointer     data)
 {
-    UZBL_UNUSED (session);
     UZBL_UNUSED (data);
 
+    UzblDiskCache *disk_cache = uzbl.net.disk_cache;
+
+    if (disk_cache && disk_cache->dir && !disk_cache->cache &&
+        (g_get_monotonic_time () >= disk_cache->next_attempt)) {
+        disk_cache_attach (session);
+    }
+
+    if (disk_cache && disk_cache->cache && (msg->method == SOUP_METHOD_GET)) {
+        g_object_connect (G_OBJECT (msg),
+            "signal::finished", G_CALLBACK (cache_finished_cb), NULL,
+            NULL);
+    }
+
+    if (!g_object_get_data (G_OBJECT (msg), UZBL_METRICS_KEY)) {
+        UzblRequestMetrics *metrics = g_malloc0 (sizeof (UzblRequestMetrics));
+
+        metrics->queued = g_get_monotonic_time ();
+        g_object_set_data_full (G_OBJECT (msg), UZBL_METRICS_KEY, metrics, g_free);
+
+        g_object_connect (G_OBJECT (msg),
+            "signal::got-headers", G_CALLBACK (metrics_headers_cb), metrics,
+            "signal::got-chunk",   G_CALLBACK (metrics_chunk_cb), metrics,
+            "signal::finished",    G_CALLBACK (metrics_finished_cb), metrics,
+            NULL);
+    }
+
     gchar *str = soup_uri_to_string (soup_message_get_uri (msg), FALSE);
 
     uzbl_events_send (REQUEST_QUEUED, NULL,
@@ -77,6 +499,8 @@ request_queued_cb (SoupSession *session,
 static void
 request_finished_cb (SoupMessage *msg, gpointer data);
 
+#define UZBL_SENT_KEY "uzbl-sent"
+
 void
 request_started_cb (SoupSession *session,
                     SoupMessage *msg,
@@ -85,6 +509,28 @@ request_started_cb (SoupSession *session,
     UZBL_UNUSED (session);
     UZBL_UNUSED (data);
 
+    g_object_set_data (G_OBJECT (msg), UZBL_SENT_KEY, GINT_TO_POINTER (TRUE));
+
+    UzblRequestMetrics *metrics = g_object_get_data (G_OBJECT (msg), UZBL_METRICS_KEY);
+
+    /* Only the first attempt is timed if the message is restarted. */
+    if (metrics && !metrics->started) {
+        metrics->started = g_get_monotonic_time ();
+    }
+
+    UzblPreconnect *preconnect = uzbl.net.preconnect;
+    const gchar *host = soup_message_get_uri (msg)->host;
+    gint64 *when = host ? g_hash_table_lookup (preconnect->hosts, host) : NULL;
+
+    /* Each lookup counts as a hit at most once. */
+    if (when) {
+        if (g_get_monotonic_time () - *when < UZBL_PRECONNECT_WINDOW) {
+            ++preconnect->hits;
+        }
+
+        g_hash_table_remove (preconnect->hosts, host);
+    }
+
     gchar *str = soup_uri_to_string (soup_message_get_uri (msg), FALSE);
 
     uzbl_events_send (REQUEST_STARTING, NULL,
@@ -112,6 +558,178 @@ request_finished_cb (SoupMessage *msg, gpointer data)
     g_free (str);
 }
 
+void
+cache_finished_cb (SoupMessage *msg, gpointer data)
+{
+    UZBL_UNUSED (data);
+
+    UzblDiskCache *disk_cache = uzbl.net.disk_cache;
+
+    if (!disk_cache) {
+        return;
+    }
+
+    /* Responses answered by the cache never reach the network. */
+    if (!g_object_get_data (G_OBJECT (msg), UZBL_SENT_KEY)) {
+        if (SOUP_STATUS_IS_SUCCESSFUL (msg->status_code)) {
+            ++disk_cache->hits;
+        }
+    } else if (msg->status_code == SOUP_STATUS_NOT_MODIFIED) {
+        ++disk_cache->validations;
+    } else {
+        ++disk_cache->misses;
+    }
+}
+
+void
+metrics_headers_cb (SoupMessage *msg, gpointer data)
+{
+    UZBL_UNUSED (msg);
+
+    UzblRequestMetrics *metrics = (UzblRequestMetrics *)data;
+
+    metrics->headers = g_get_monotonic_time ();
+}
+
+void
+metrics_chunk_cb (SoupMessage *msg, SoupBuffer *chunk, gpointer data)
+{
+    UZBL_UNUSED (msg);
+
+    UzblRequestMetrics *metrics = (UzblRequestMetrics *)data;
+
+    metrics->bytes += chunk->length;
+}
+
+static void
+page_metrics_add (const gchar *uri, guint status, const gchar *source,
+                  UzblRequestMetrics *metrics, gint64 finished, gsize bytes);
+
+void
+metrics_finished_cb (SoupMessage *msg, gpointer data)
+{
+    UzblRequestMetrics *metrics = (UzblRequestMetrics *)data;
+    gint64 finished = g_get_monotonic_time ();
+    gsize bytes = metrics->bytes;
+    const gchar *source = "network";
+
+    if (!g_object_get_data (G_OBJECT (msg), UZBL_SENT_KEY)) {
+        source = SOUP_STATUS_IS_SUCCESSFUL (msg->status_code) ? "cache" : "none";
+    } else if (msg->status_code == SOUP_STATUS_NOT_MODIFIED) {
+        source = "revalidated";
+    }
+
+    /* Bodies read through a stream (and cached bodies) do not go through
+     * got-chunk, so fall back to the advertised length. */
+    if (!bytes) {
+        goffset length = soup_message_headers_get_content_length (msg->response_headers);
+
+        bytes = MAX (length, 0);
+    }
+
+    gchar *uri = soup_uri_to_string (soup_message_get_uri (msg), FALSE);
+
+    /* Milestones are offsets from when the request was queued (-1 if it
+     * never got there). */
+    uzbl_events_send (REQUEST_METRICS, NULL,
+        TYPE_STR, uri,
+        TYPE_INT, msg->status_code,
+        TYPE_ULL, (unsigned long long)metrics->queued,
+        TYPE_LL, (long long)(metrics->started ? (metrics->started - metrics->queued) : -1),
+        TYPE_LL, (long long)(metrics->headers ? (metrics->headers - metrics->queued) : -1),
+        TYPE_LL, (long long)(finished - metrics->queued),
+        TYPE_ULL, (unsigned long long)bytes,
+        TYPE_STR, source,
+        NULL);
+
+    page_metrics_add (uri, msg->status_code, source, metrics, finished, bytes);
+
+    g_free (uri);
+}
+
+void
+page_metrics_add (const gchar *uri, guint status, const gchar *source,
+                  UzblRequestMetrics *metrics, gint64 finished, gsize bytes)
+{
+    UzblPageMetrics *page = uzbl.net.page_metrics;
+
+    if (!page || !page->active) {
+        return;
+    }
+
+    ++page->requests;
+    if (!g_strcmp0 (source, "cache") || !g_strcmp0 (source, "revalidated")) {
+        ++page->cached;
+    }
+    page->bytes += bytes;
+    page->last_finished = MAX (page->last_finished, finished);
+
+    if (page->entries->len) {
+        g_string_append_c (page->entries, ',');
+    }
+
+    /* Times are relative to the start of the page load. */
+#define since_start(time) ((time) ? ((time) - page->start) : -1)
+
+    g_string_append (page->entries, "{\"uri\":");
+    uzbl_comm_string_append_json (page->entries, uri);
+    g_string_append_printf (page->entries,
+        ",\"status\":%u,\"source\":\"%s\""
+        ",\"queued_us\":%" G_GINT64_FORMAT
+        ",\"started_us\":%" G_GINT64_FORMAT
+        ",\"headers_us\":%" G_GINT64_FORMAT
+        ",\"finished_us\":%" G_GINT64_FORMAT
+        ",\"bytes\":%" G_GSIZE_FORMAT "}",
+        status, source,
+        since_start (metrics->queued),
+        since_start (metrics->started),
+        since_start (metrics->headers),
+        since_start (finished),
+        bytes);
+
+#undef since_start
+}
+
+void
+prune_preconnected (gint64 now)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init (&iter, uzbl.net.preconnect->hosts);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+        if (now - *(gint64 *)value >= UZBL_PRECONNECT_WINDOW) {
+            g_hash_table_iter_remove (&iter);
+        }
+    }
+}
+
+#ifdef HAVE_LIBSOUP_CHECK_VERSION
+void
+prefetch_done_cb (SoupAddress *address, guint status, gpointer data)
+{
+    UZBL_UNUSED (address);
+    UZBL_UNUSED (status);
+    UZBL_UNUSED (data);
+
+    if (uzbl.net.preconnect) {
+        --uzbl.net.preconnect->in_flight;
+    }
+}
+#endif
+
+gboolean
+hover_timeout_cb (gpointer data)
+{
+    UzblPreconnect *preconnect = uzbl.net.preconnect;
+
+    preconnect->hover_id = 0;
+
+    uzbl_soup_preconnect (SOUP_SESSION (data), preconnect->hover_uri);
+
+    return FALSE;
+}
+
 typedef struct {
     SoupSession *session;
     SoupMessage *message;
@@ -5,6 +5,8 @@
 
 void
 uzbl_soup_init (SoupSession *session);
+void
+uzbl_soup_free (SoupSession *session);
 
 void
 uzbl_soup_disable_builtin_auth (SoupSession *session);
@@ -12,4 +14,53 @@ uzbl_soup_disable_builtin_auth (SoupSession *session);
 void
 uzbl_soup_enable_builtin_auth (SoupSession *session);
 
+/* Only one instance at a time may use a cache directory. Others skip the disk
+ * cache and take it over once the owner is done with it. */
+void
+uzbl_soup_set_disk_cache_dir (SoupSession *session, const gchar *dir);
+const gchar *
+uzbl_soup_get_disk_cache_dir ();
+void
+uzbl_soup_set_disk_cache_size (guint size);
+guint
+uzbl_soup_get_disk_cache_size ();
+
+/* Requests answered from the cache (including after revalidation),
+ * revalidations which were not modified and requests sent to the network
+ * with the cache attached. */
+guint
+uzbl_soup_get_disk_cache_hits ();
+guint
+uzbl_soup_get_disk_cache_validations ();
+guint
+uzbl_soup_get_disk_cache_misses ();
+
+/* Resolves the host of uri ahead of a request for it. At most max_conns_host
+ * lookups are running at a time. */
+void
+uzbl_soup_preconnect (SoupSession *session, const gchar *uri);
+/* Called whenever the hovered link changes (uri is NULL when no link is
+ * hovered). Links hovered for longer than the delay (in milliseconds, 0
+ * disables this) are preconnected. */
+void
+uzbl_soup_hover (SoupSession *session, const gchar *uri);
+void
+uzbl_soup_set_preconnect_delay (guint delay);
+guint
+uzbl_soup_get_preconnect_delay ();
+
+/* Hosts which were preconnected and how many of them were requested shortly
+ * afterwards. */
+guint
+uzbl_soup_get_preconnect_count ();
+guint
+uzbl_soup_get_preconnect_hits ();
+
+/* Requests finishing between these calls are summarized in a PAGE_METRICS
+ * event when the page has finished (or failed) loading. */
+void
+uzbl_soup_page_start ();
+void
+uzbl_soup_page_finish (const gchar *uri);
+
 #endif
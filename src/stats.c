@@ -0,0 +1,256 @@
+#include "stats.h"
+
+#include "comm.h"
+#include "setup.h"
+#include "uzbl-core.h"
+
+/* Durations are bucketed by powers of two of microseconds; bucket i holds
+ * durations below 2^i us and the last bucket holds anything longer. */
+#define UZBL_STATS_BUCKETS 24
+
+struct _UzblStatsEntry {
+    volatile gint  count;
+    volatile gsize total_us;
+    volatile gsize bytes;
+    volatile gint  buckets[UZBL_STATS_BUCKETS];
+};
+
+struct _UzblStats {
+    /* Only guards the tables (adding entries and taking snapshots); counters
+     * are updated atomically. */
+    GMutex      lock;
+    GHashTable *groups[UZBL_STATS_GROUP_LAST];
+};
+
+static const struct {
+    const gchar *name;
+    gboolean     bytes;
+} group_info[UZBL_STATS_GROUP_LAST] = {
+    { "events",     FALSE },
+    { "sockets",    TRUE  },
+    { "commands",   FALSE },
+    { "spawns",     FALSE },
+    { "requests",   FALSE },
+    { "expansions", FALSE }
+};
+
+/* =========================== PUBLIC API =========================== */
+
+void
+uzbl_stats_init ()
+{
+    guint i;
+
+    uzbl.stats = g_malloc (sizeof (UzblStats));
+
+    g_mutex_init (&uzbl.stats->lock);
+    for (i = 0; i < UZBL_STATS_GROUP_LAST; ++i) {
+        uzbl.stats->groups[i] = g_hash_table_new_full (g_str_hash, g_str_equal,
+            g_free, g_free);
+    }
+}
+
+void
+uzbl_stats_free ()
+{
+    guint i;
+
+    if (!uzbl.stats) {
+        return;
+    }
+
+    for (i = 0; i < UZBL_STATS_GROUP_LAST; ++i) {
+        g_hash_table_destroy (uzbl.stats->groups[i]);
+    }
+    g_mutex_clear (&uzbl.stats->lock);
+
+    g_free (uzbl.stats);
+    uzbl.stats = NULL;
+}
+
+static UzblStatsEntry *
+get_entry (UzblStatsGroup group, const gchar *name);
+static void
+add_to_entry (UzblStatsEntry *entry, gint64 start, gsize bytes);
+
+void
+uzbl_stats_record (UzblStatsGroup group, const gchar *name, gint64 start, gsize bytes)
+{
+    if (!uzbl.stats || !name) {
+        return;
+    }
+
+    add_to_entry (get_entry (group, name), start, bytes);
+}
+
+void
+uzbl_stats_record_cached (UzblStatsEntry **entry, UzblStatsGroup group, const gchar *name, gint64 start, gsize bytes)
+{
+    if (!uzbl.stats) {
+        return;
+    }
+
+    UzblStatsEntry *cached = g_atomic_pointer_get (entry);
+
+    if (!cached) {
+        if (!name) {
+            return;
+        }
+
+        /* Racing lookups find the same entry. */
+        cached = get_entry (group, name);
+        g_atomic_pointer_set (entry, cached);
+    }
+
+    add_to_entry (cached, start, bytes);
+}
+
+static void
+group_to_json (GString *buf, UzblStatsGroup group);
+
+gboolean
+uzbl_stats_to_json (GString *buf, const gchar *group)
+{
+    guint i;
+
+    if (!uzbl.stats) {
+        return FALSE;
+    }
+
+    if (group) {
+        for (i = 0; i < UZBL_STATS_GROUP_LAST; ++i) {
+            if (!g_strcmp0 (group, group_info[i].name)) {
+                group_to_json (buf, i);
+                return TRUE;
+            }
+        }
+
+        return FALSE;
+    }
+
+    g_string_append_c (buf, '{');
+    for (i = 0; i < UZBL_STATS_GROUP_LAST; ++i) {
+        if (i) {
+            g_string_append_c (buf, ',');
+        }
+
+        uzbl_comm_string_append_json (buf, group_info[i].name);
+        g_string_append_c (buf, ':');
+        group_to_json (buf, i);
+    }
+    g_string_append_c (buf, '}');
+
+    return TRUE;
+}
+
+/* ===================== HELPER IMPLEMENTATIONS ===================== */
+
+UzblStatsEntry *
+get_entry (UzblStatsGroup group, const gchar *name)
+{
+    GHashTable *table = uzbl.stats->groups[group];
+
+    g_mutex_lock (&uzbl.stats->lock);
+
+    UzblStatsEntry *entry = g_hash_table_lookup (table, name);
+
+    if (!entry) {
+        entry = g_malloc0 (sizeof (UzblStatsEntry));
+        g_hash_table_insert (table, g_strdup (name), entry);
+    }
+
+    g_mutex_unlock (&uzbl.stats->lock);
+
+    return entry;
+}
+
+static guint
+bucket_for (gint64 duration);
+
+void
+add_to_entry (UzblStatsEntry *entry, gint64 start, gsize bytes)
+{
+    gint64 duration = MAX (g_get_monotonic_time () - start, 0);
+
+    g_atomic_int_inc (&entry->count);
+    g_atomic_pointer_add (&entry->total_us, duration);
+    if (bytes) {
+        g_atomic_pointer_add (&entry->bytes, bytes);
+    }
+    g_atomic_int_inc (&entry->buckets[bucket_for (duration)]);
+}
+
+guint
+bucket_for (gint64 duration)
+{
+    guint bucket = 0;
+
+    while (duration && (bucket < (UZBL_STATS_BUCKETS - 1))) {
+        duration >>= 1;
+        ++bucket;
+    }
+
+    return bucket;
+}
+
+static void
+entry_to_json (GString *buf, UzblStatsEntry *entry, gboolean bytes);
+
+void
+group_to_json (GString *buf, UzblStatsGroup group)
+{
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+    gboolean first = TRUE;
+
+    g_string_append_c (buf, '{');
+
+    g_mutex_lock (&uzbl.stats->lock);
+
+    g_hash_table_iter_init (&iter, uzbl.stats->groups[group]);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        if (!first) {
+            g_string_append_c (buf, ',');
+        }
+        first = FALSE;
+
+        uzbl_comm_string_append_json (buf, key);
+        g_string_append_c (buf, ':');
+        entry_to_json (buf, value, group_info[group].bytes);
+    }
+
+    g_mutex_unlock (&uzbl.stats->lock);
+
+    g_string_append_c (buf, '}');
+}
+
+void
+entry_to_json (GString *buf, UzblStatsEntry *entry, gboolean bytes)
+{
+    guint last = 0;
+    guint i;
+
+    g_string_append_printf (buf, "{\"count\":%d,\"total_us\":%" G_GSIZE_FORMAT,
+        g_atomic_int_get (&entry->count),
+        (gsize)g_atomic_pointer_get (&entry->total_us));
+
+    if (bytes) {
+        g_string_append_printf (buf, ",\"bytes\":%" G_GSIZE_FORMAT,
+            (gsize)g_atomic_pointer_get (&entry->bytes));
+    }
+
+    /* Trailing empty buckets are left out. */
+    for (i = 0; i < UZBL_STATS_BUCKETS; ++i) {
+        if (g_atomic_int_get (&entry->buckets[i])) {
+            last = i + 1;
+        }
+    }
+
+    g_string_append (buf, ",\"histogram\":[");
+    for (i = 0; i < last; ++i) {
+        g_string_append_printf (buf, i ? ",%d" : "%d",
+            g_atomic_int_get (&entry->buckets[i]));
+    }
+    g_string_append (buf, "]}");
+}
@@ -0,0 +1,38 @@
+#ifndef UZBL_STATS_H
+#define UZBL_STATS_H
+
+#include <glib.h>
+
+typedef enum {
+    UZBL_STATS_EVENTS,
+    UZBL_STATS_SOCKETS,
+    UZBL_STATS_COMMANDS,
+    UZBL_STATS_SPAWNS,
+    UZBL_STATS_REQUESTS,
+    UZBL_STATS_EXPANSIONS,
+
+    UZBL_STATS_GROUP_LAST
+} UzblStatsGroup;
+
+struct _UzblStatsEntry;
+typedef struct _UzblStatsEntry UzblStatsEntry;
+
+/* Counts one occurrence of name in group which started at start (from
+ * g_get_monotonic_time) and moved bytes bytes. Safe to call from any
+ * thread. */
+void
+uzbl_stats_record (UzblStatsGroup group, const gchar *name, gint64 start, gsize bytes);
+
+/* Like uzbl_stats_record, but only looks name up while *entry is NULL and
+ * keeps the counters found there for later calls, which may pass a NULL
+ * name. Entries stay valid until the statistics are freed, so hot paths can
+ * keep them in static storage. */
+void
+uzbl_stats_record_cached (UzblStatsEntry **entry, UzblStatsGroup group, const gchar *name, gint64 start, gsize bytes);
+
+/* Appends the counters (of one group if group is not NULL) as a JSON
+ * object. Returns FALSE if there is no such group. */
+gboolean
+uzbl_stats_to_json (GString *buf, const gchar *group);
+
+#endif
@@ -0,0 +1,169 @@
+#include "timeline.h"
+
+#include "comm.h"
+#include "events.h"
+#include "setup.h"
+#include "type.h"
+#include "util.h"
+#include "uzbl-core.h"
+
+#include <unistd.h>
+
+typedef struct {
+    gchar  *phase;
+    gchar  *detail;
+    gint64  start;
+    gint64  end;
+    guint   depth;
+} UzblTimelineSpan;
+
+struct _UzblTimeline {
+    /* Monotonic time at which uzbl_init was entered. */
+    gint64  origin;
+    /* Where to write the JSON timeline to (may be NULL). */
+    gchar  *path;
+
+    GArray *spans;
+    guint   depth;
+};
+
+/* =========================== PUBLIC API =========================== */
+
+static void
+span_clear (gpointer data);
+
+void
+uzbl_timeline_init (gint64 origin, const gchar *path)
+{
+    uzbl.timeline = g_malloc (sizeof (UzblTimeline));
+
+    uzbl.timeline->origin = origin;
+    uzbl.timeline->path = g_strdup (path);
+
+    uzbl.timeline->spans = g_array_new (FALSE, TRUE, sizeof (UzblTimelineSpan));
+    g_array_set_clear_func (uzbl.timeline->spans, span_clear);
+    uzbl.timeline->depth = 0;
+}
+
+void
+uzbl_timeline_free ()
+{
+    if (!uzbl.timeline) {
+        return;
+    }
+
+    g_array_free (uzbl.timeline->spans, TRUE);
+    g_free (uzbl.timeline->path);
+
+    g_free (uzbl.timeline);
+    uzbl.timeline = NULL;
+}
+
+guint
+uzbl_timeline_begin (const gchar *phase, const gchar *detail)
+{
+    if (!uzbl.timeline) {
+        return 0;
+    }
+
+    UzblTimelineSpan span;
+
+    span.phase = g_strdup (phase);
+    span.detail = g_strdup (detail);
+    span.start = g_get_monotonic_time ();
+    span.end = 0;
+    span.depth = uzbl.timeline->depth++;
+
+    g_array_append_val (uzbl.timeline->spans, span);
+
+    return uzbl.timeline->spans->len;
+}
+
+void
+uzbl_timeline_end (guint span)
+{
+    if (!uzbl.timeline || !span || (span > uzbl.timeline->spans->len)) {
+        return;
+    }
+
+    UzblTimelineSpan *entry = &g_array_index (uzbl.timeline->spans, UzblTimelineSpan, span - 1);
+
+    entry->end = g_get_monotonic_time ();
+    --uzbl.timeline->depth;
+}
+
+static GString *
+timeline_to_json ();
+
+void
+uzbl_timeline_finish ()
+{
+    if (!uzbl.timeline) {
+        return;
+    }
+
+    GString *json = timeline_to_json ();
+
+    uzbl_events_send (STARTUP_TIMELINE, NULL,
+        TYPE_STR, json->str,
+        NULL);
+
+    if (uzbl.timeline->path) {
+        GError *error = NULL;
+
+        g_string_append_c (json, '\n');
+
+        if (!g_file_set_contents (uzbl.timeline->path, json->str, json->len, &error)) {
+            g_warning ("Failed to write startup timeline to %s: %s\n", uzbl.timeline->path, error->message);
+            g_error_free (error);
+        }
+    }
+
+    g_string_free (json, TRUE);
+
+    /* Only startup is traced. */
+    uzbl_timeline_free ();
+}
+
+/* ===================== HELPER IMPLEMENTATIONS ===================== */
+
+void
+span_clear (gpointer data)
+{
+    UzblTimelineSpan *span = (UzblTimelineSpan *)data;
+
+    g_free (span->phase);
+    g_free (span->detail);
+}
+
+GString *
+timeline_to_json ()
+{
+    GString *json = g_string_new ("");
+    gint64 origin = uzbl.timeline->origin;
+    guint i;
+
+    g_string_append_printf (json, "{\"pid\":%d,\"total_us\":%" G_GINT64_FORMAT ",\"spans\":[",
+        (int)getpid (), g_get_monotonic_time () - origin);
+
+    for (i = 0; i < uzbl.timeline->spans->len; ++i) {
+        const UzblTimelineSpan *span = &g_array_index (uzbl.timeline->spans, UzblTimelineSpan, i);
+
+        if (i) {
+            g_string_append_c (json, ',');
+        }
+
+        g_string_append (json, "{\"phase\":");
+        uzbl_comm_string_append_json (json, span->phase);
+        g_string_append (json, ",\"detail\":");
+        uzbl_comm_string_append_json (json, span->detail);
+        g_string_append_printf (json, ",\"depth\":%u,\"start_us\":%" G_GINT64_FORMAT ",\"end_us\":%" G_GINT64_FORMAT "}",
+            span->depth,
+            span->start - origin,
+            span->end ? span->end - origin : -1);
+    }
+
+    g_string_append (json, "]}");
+
+    return json;
+}
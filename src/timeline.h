@@ -0,0 +1,22 @@
+#ifndef UZBL_TIMELINE_H
+#define UZBL_TIMELINE_H
+
+#include <glib.h>
+
+/* Spans are only recorded while a timeline is active; a span of 0 means
+ * nothing was recorded. */
+guint
+uzbl_timeline_begin (const gchar *phase, const gchar *detail);
+void
+uzbl_timeline_end (guint span);
+
+#define uzbl_timeline_run(phase, call)                    \
+    do                                                    \
+    {                                                     \
+        guint timeline_span = uzbl_timeline_begin (phase, \
+                                                   NULL); \
+        call;                                             \
+        uzbl_timeline_end (timeline_span);                \
+    } while (FALSE)
+
+#endif
@@ -9,7 +9,8 @@ typedef enum {
     TYPE_NAME,
     /* Used by send_event. */
     TYPE_FORMATTEDSTR,
-    TYPE_STR_ARRAY
+    TYPE_STR_ARRAY,
+    TYPE_LL
 } UzblType;
 
 #endif
@@ -36,6 +36,7 @@
 #include "io.h"
 #include "setup.h"
 #include "soup.h"
+#include "timeline.h"
 #include "type.h"
 #include "util.h"
 #include "variables.h"
@@ -62,6 +63,7 @@ read_config_file (const gchar *file);
 void
 uzbl_init (int *argc, char ***argv)
 {
+    gint64 start_time = g_get_monotonic_time ();
     gchar *uri = NULL;
     gboolean verbose = FALSE;
     gchar *config_file = NULL;
@@ -70,6 +72,7 @@ uzbl_init (int *argc, char ***argv)
     gchar *geometry = NULL;
     gboolean print_version = FALSE;
     gboolean bug_info = FALSE;
+    gchar *startup_trace = NULL;
 
     /* Commandline arguments. */
     const GOptionEntry
@@ -85,6 +88,8 @@ uzbl_init (int *argc, char ***argv)
             "Xembed socket ID, this window should embed itself",                                             "SOCKET" },
         { "connect-socket",     0,  0, G_OPTION_ARG_STRING_ARRAY, &connect_socket_names,
             "Connect to server socket for event managing",                                                   "CSOCKET" },
+        { "config-cache",       0,  0, G_OPTION_ARG_STRING,       &uzbl.state.config_cache_dir,
+            "Directory to keep snapshots of loaded config files in",                                         "DIR" },
         { "print-events",      'p', 0, G_OPTION_ARG_NONE,         &print_events,
             "Whether to print events to stdout.",                                                            NULL },
         { "geometry",          'g', 0, G_OPTION_ARG_STRING,       &geometry,
@@ -93,6 +98,8 @@ uzbl_init (int *argc, char ***argv)
             "Print the version and exit",                                                                    NULL },
         { "bug-info",          'B', 0, G_OPTION_ARG_NONE,         &bug_info,
             "Print information for a bug report and exit",                                                   NULL },
+        { "startup-trace",      0,  0, G_OPTION_ARG_FILENAME,     &startup_trace,
+            "Record the startup timeline and write it as JSON to FILE",                                      "FILE" },
         { NULL,      0, 0, 0, NULL, NULL, NULL }
     };
 
@@ -154,6 +161,16 @@ uzbl_init (int *argc, char ***argv)
         exit (EXIT_SUCCESS);
     }
 
+    /* Startup tracing. */
+    if (!startup_trace) {
+        startup_trace = g_strdup (g_getenv ("UZBL_STARTUP_TRACE"));
+    }
+
+    if (startup_trace && *startup_trace) {
+        uzbl_timeline_init (start_time, g_strcmp0 (startup_trace, "-") ? startup_trace : NULL);
+    }
+    g_free (startup_trace);
+
     /* Embedded mode. */
     if (uzbl.state.xembed_socket_id) {
         uzbl.state.plug_mode = TRUE;
@@ -165,25 +182,30 @@ uzbl_init (int *argc, char ***argv)
     }
 #endif
 
+    uzbl_stats_init ();
+
     /* HTTP client. */
+    guint span = uzbl_timeline_begin ("soup", NULL);
     uzbl.net.soup_session = webkit_get_default_session ();
     uzbl_soup_init (uzbl.net.soup_session);
+    uzbl_timeline_end (span);
 
-    uzbl_io_init ();
-    uzbl_js_init ();
-    uzbl_variables_init ();
-    uzbl_commands_init ();
-    uzbl_events_init ();
-    uzbl_requests_init ();
+    uzbl_timeline_run ("io", uzbl_io_init ());
+    uzbl_timeline_run ("js", uzbl_js_init ());
+    uzbl_timeline_run ("variables", uzbl_variables_init ());
+    uzbl_timeline_run ("commands", uzbl_commands_init ());
+    uzbl_timeline_run ("events", uzbl_events_init ());
+    uzbl_timeline_run ("requests", uzbl_requests_init ());
 
-    uzbl_scheme_init ();
+    uzbl_timeline_run ("scheme", uzbl_scheme_init ());
+    uzbl_timeline_run ("pages", uzbl_pages_init ());
 
     /* Initialize the GUI. */
-    uzbl_gui_init ();
-    uzbl_inspector_init ();
+    uzbl_timeline_run ("gui", uzbl_gui_init ());
+    uzbl_timeline_run ("inspector", uzbl_inspector_init ());
 
 #if WEBKIT_CHECK_VERSION (2, 9, 4)
-    uzbl_variables_setup_data_manager ();
+    uzbl_timeline_run ("data_manager", uzbl_variables_setup_data_manager ());
 #endif
 
     /* Uzbl has now been started. */
@@ -193,11 +215,13 @@ uzbl_init (int *argc, char ***argv)
     ensure_xdg_vars ();
 
     /* Connect to the event manager(s). */
+    span = uzbl_timeline_begin ("connect", NULL);
     gchar **name = connect_socket_names;
     while (name && *name) {
         uzbl_io_init_connect_socket (*name++);
     }
     uzbl_io_flush_buffer ();
+    uzbl_timeline_end (span);
 
     /* Send the startup event. */
     pid_t pid = getpid ();
@@ -225,13 +249,15 @@ uzbl_init (int *argc, char ***argv)
     }
 
     /* Load default config. */
+    span = uzbl_timeline_begin ("default_config", NULL);
     const gchar * const *default_command = default_config;
     while (default_command && *default_command) {
         uzbl_commands_run (*default_command++, NULL);
     }
+    uzbl_timeline_end (span);
 
     /* Load provided configuration file. */
-    read_config_file (config_file);
+    uzbl_timeline_run ("config", read_config_file (config_file));
 
     if (uzbl.gui.main_window) {
         /* We need to ensure there is a window, before we can get XID. */
@@ -250,6 +276,7 @@ uzbl_init (int *argc, char ***argv)
     }
 
     /* Navigate to a URI if requested. */
+    span = uzbl_timeline_begin ("show", NULL);
     if (uri) {
         GArray *argv = uzbl_commands_args_new ();
         uzbl_commands_args_append (argv, g_strdup (uri));
@@ -280,6 +307,9 @@ uzbl_init (int *argc, char ***argv)
 
     /* Update status bar. */
     uzbl_gui_update_title ();
+    uzbl_timeline_end (span);
+
+    uzbl_timeline_finish ();
 }
 
 void
@@ -292,9 +322,13 @@ uzbl_free ()
     uzbl_inspector_free ();
     uzbl_gui_free ();
     uzbl_requests_free ();
+    uzbl_pages_free ();
     uzbl_commands_free ();
+    uzbl_soup_free (uzbl.net.soup_session);
     uzbl_variables_free ();
     uzbl_io_free ();
+    uzbl_timeline_free ();
+    uzbl_stats_free ();
 
     if (uzbl.gui.menu_items) {
         g_ptr_array_free (uzbl.gui.menu_items, TRUE);
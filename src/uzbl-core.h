@@ -43,6 +43,7 @@ typedef struct {
     gchar          *last_result;
     gboolean        plug_mode;
     JSGlobalContextRef jscontext;
+    gchar          *config_cache_dir;
 
     gboolean        started;
     gboolean        gtk_started;
@@ -52,11 +53,23 @@ typedef struct {
     int             xembed_socket_id;
 } UzblState;
 
+struct _UzblDiskCache;
+typedef struct _UzblDiskCache UzblDiskCache;
+
+struct _UzblPreconnect;
+typedef struct _UzblPreconnect UzblPreconnect;
+
+struct _UzblPageMetrics;
+typedef struct _UzblPageMetrics UzblPageMetrics;
+
 /* Networking */
 typedef struct {
-    SoupSession    *soup_session;
-    UzblCookieJar  *soup_cookie_jar;
-    gulong          builtin_auth_id;
+    SoupSession     *soup_session;
+    UzblCookieJar   *soup_cookie_jar;
+    UzblDiskCache   *disk_cache;
+    UzblPreconnect  *preconnect;
+    UzblPageMetrics *page_metrics;
+    gulong           builtin_auth_id;
 } UzblNetwork;
 
 struct _UzblCommands;
@@ -71,9 +84,18 @@ typedef struct _UzblInspector UzblInspector;
 struct _UzblIO;
 typedef struct _UzblIO UzblIO;
 
+struct _UzblPages;
+typedef struct _UzblPages UzblPages;
+
 struct _UzblRequests;
 typedef struct _UzblRequests UzblRequests;
 
+struct _UzblStats;
+typedef struct _UzblStats UzblStats;
+
+struct _UzblTimeline;
+typedef struct _UzblTimeline UzblTimeline;
+
 struct _UzblVariables;
 typedef struct _UzblVariables UzblVariables;
 
@@ -87,7 +109,10 @@ typedef struct {
     UzblGui          *gui_;
     UzblInspector    *inspector;
     UzblIO           *io;
+    UzblPages        *pages;
     UzblRequests     *requests;
+    UzblStats        *stats;
+    UzblTimeline     *timeline;
     UzblVariables    *variables;
 } UzblCore;
 
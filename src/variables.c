@@ -5,11 +5,13 @@
 #include "gui.h"
 #include "io.h"
 #include "js.h"
+#include "property-cache.h"
 #include "sync.h"
 #include "type.h"
 #include "util.h"
 #include "comm.h"
 #include "soup.h"
+#include "stats.h"
 #include "uzbl-core.h"
 
 #include <JavaScriptCore/JavaScript.h>
@@ -375,12 +377,38 @@ typedef enum {
 } UzblExpandStage;
 
 static gchar *
-expand_impl (const gchar *str, UzblExpandStage stage);
+expand_impl (const gchar *str, UzblExpandStage stage, UzblExpandTrace *trace);
 
 gchar *
 uzbl_variables_expand (const gchar *str)
 {
-    return expand_impl (str, EXPAND_INITIAL);
+    return uzbl_variables_expand_traced (str, NULL);
+}
+
+gchar *
+uzbl_variables_expand_traced (const gchar *str, UzblExpandTrace *trace)
+{
+    gint64 start = g_get_monotonic_time ();
+    gchar *expanded = expand_impl (str, EXPAND_INITIAL, trace);
+
+    static UzblStatsEntry *expand_stats = NULL;
+
+    uzbl_stats_record_cached (&expand_stats, UZBL_STATS_EXPANSIONS, "expand", start, 0);
+
+    return expanded;
+}
+
+static void
+variable_expand (const UzblVariable *var, GString *buf);
+
+gchar *
+uzbl_variables_get_expanded (const gchar *name)
+{
+    GString *buf = g_string_new ("");
+
+    variable_expand (get_variable (name), buf);
+
+    return g_string_free (buf, FALSE);
 }
 
 #define VAR_GETTER(type, name)                     \
@@ -613,7 +641,7 @@ static UzblExpandType
 expand_type (const gchar *str);
 
 gchar *
-expand_impl (const gchar *str, UzblExpandStage stage)
+expand_impl (const gchar *str, UzblExpandStage stage, UzblExpandTrace *trace)
 {
     GString *buf = g_string_new ("");
 
@@ -689,10 +717,22 @@ expand_impl (const gchar *str, UzblExpandStage stage)
                 ++vend;
                 /* FALLTHROUGH */
             case EXPAND_VAR:
-                variable_expand (get_variable (ret), buf);
+            {
+                const UzblVariable *var = get_variable (ret);
+
+                if (trace && !g_hash_table_contains (trace->inputs, ret)) {
+                    GString *seen = g_string_new ("");
+                    variable_expand (var, seen);
+
+                    g_hash_table_insert (trace->inputs,
+                        g_strdup (ret), g_string_free (seen, FALSE));
+                }
+
+                variable_expand (var, buf);
 
                 p = vend;
                 break;
+            }
             case EXPAND_SHELL:
             {
                 if (stage == EXPAND_IGNORE_SHELL) {
@@ -714,7 +754,14 @@ expand_impl (const gchar *str, UzblExpandStage stage)
                     quote = TRUE;
                 }
 
-                gchar *exp_cmd = expand_impl (cmd, EXPAND_IGNORE_SHELL);
+                /* The output depends on whatever the command reads (files,
+                 * the clock, ...) and running it may have side effects, so
+                 * the line is run again when replayed. */
+                if (trace) {
+                    trace->cacheable = FALSE;
+                }
+
+                gchar *exp_cmd = expand_impl (cmd, EXPAND_IGNORE_SHELL, trace);
 
                 if (quote) {
                     gchar *quoted = g_shell_quote (exp_cmd);
@@ -748,19 +795,24 @@ expand_impl (const gchar *str, UzblExpandStage stage)
                     break;
                 }
 
+                /* Commands may have side effects. */
+                if (trace) {
+                    trace->cacheable = FALSE;
+                }
+
                 GString *uzbl_ret = g_string_new ("");
 
                 GArray *tmp = uzbl_commands_args_new ();
 
                 if (*ret == '+') {
                     /* Read commands from file. */
-                    gchar *mycmd = expand_impl (ret + 1, EXPAND_IGNORE_UZBL);
+                    gchar *mycmd = expand_impl (ret + 1, EXPAND_IGNORE_UZBL, trace);
                     g_array_append_val (tmp, mycmd);
 
                     uzbl_commands_run_argv ("include", tmp, uzbl_ret);
                 } else {
                     /* Command string. */
-                    gchar *mycmd = expand_impl (ret, EXPAND_IGNORE_UZBL);
+                    gchar *mycmd = expand_impl (ret, EXPAND_IGNORE_UZBL, trace);
 
                     uzbl_commands_run (mycmd, uzbl_ret);
                 }
@@ -794,6 +846,11 @@ expand_impl (const gchar *str, UzblExpandStage stage)
                     break;
                 }
 
+                /* JavaScript depends on the page state. */
+                if (trace) {
+                    trace->cacheable = FALSE;
+                }
+
                 GString *js_ret = g_string_new ("");
 
                 GArray *tmp = uzbl_commands_args_new ();
@@ -812,7 +869,7 @@ expand_impl (const gchar *str, UzblExpandStage stage)
 
                 uzbl_commands_args_append (tmp, g_strdup (source));
 
-                gchar *exp_cmd = expand_impl (cmd, ignore);
+                gchar *exp_cmd = expand_impl (cmd, ignore, trace);
                 g_array_append_val (tmp, exp_cmd);
 
                 uzbl_commands_run_argv ("js", tmp, js_ret);
@@ -829,7 +886,7 @@ expand_impl (const gchar *str, UzblExpandStage stage)
             }
             case EXPAND_ESCAPE:
             {
-                gchar *exp_cmd = expand_impl (ret, EXPAND_INITIAL);
+                gchar *exp_cmd = expand_impl (ret, EXPAND_INITIAL, trace);
                 gchar *escaped = g_markup_escape_text (exp_cmd, strlen (exp_cmd));
 
                 g_string_append (buf, escaped);
@@ -1136,6 +1193,9 @@ DECLARE_SETTER (gchar *, http_debug);
 DECLARE_GETSET (gchar *, ssl_ca_file);
 DECLARE_GETSET (gchar *, ssl_policy);
 DECLARE_GETSET (gchar *, cache_model);
+DECLARE_GETSET (gchar *, disk_cache_dir);
+DECLARE_GETSET (int, disk_cache_size);
+DECLARE_GETSET (int, preconnect_delay);
 
 /* Security variables */
 DECLARE_GETSET (int, enable_private);
@@ -1143,6 +1203,7 @@ DECLARE_GETSET (int, enable_universal_file_access);
 DECLARE_GETSET (int, enable_cross_file_access);
 DECLARE_GETSET (int, enable_hyperlink_auditing);
 DECLARE_GETSET (gchar *, cookie_policy);
+DECLARE_SETTER (gchar *, shared_cookie_file);
 #if WEBKIT_CHECK_VERSION (1, 3, 13)
 DECLARE_GETSET (int, enable_dns_prefetch);
 #endif
@@ -1285,6 +1346,11 @@ DECLARE_GETTER (gchar *, geometry);
 DECLARE_GETTER (gchar *, plugin_list);
 #endif
 DECLARE_GETTER (int, is_online);
+DECLARE_GETTER (int, disk_cache_hits);
+DECLARE_GETTER (int, disk_cache_validations);
+DECLARE_GETTER (int, disk_cache_misses);
+DECLARE_GETTER (int, preconnect_count);
+DECLARE_GETTER (int, preconnect_hits);
 DECLARE_GETTER (int, WEBKIT_MAJOR);
 DECLARE_GETTER (int, WEBKIT_MINOR);
 DECLARE_GETTER (int, WEBKIT_MICRO);
@@ -1325,6 +1391,8 @@ struct _UzblVariablesPrivate {
 #if WEBKIT_CHECK_VERSION (1, 9, 0)
     gboolean default_context_menu;
 #endif
+    gchar *history_file;
+    gchar *bookmarks_file;
 
     /* Network variables */
     gchar *http_debug;
@@ -1333,6 +1401,7 @@ struct _UzblVariablesPrivate {
 
     /* Security variables */
     gboolean permissive;
+    gchar *shared_cookie_file;
     gboolean maintain_history;
 
     /* Page variables */
@@ -1384,6 +1453,8 @@ uzbl_variables_private_new (GHashTable *table)
                                           UZBL_V_FUNC (default_context_menu,                   INT)
 #endif
                                           },
+        { "history_file",                 UZBL_V_STRING (priv->history_file,                   NULL)},
+        { "bookmarks_file",               UZBL_V_STRING (priv->bookmarks_file,                 NULL)},
 
         /* Printing variables */
         { "print_backgrounds",            UZBL_V_FUNC (print_backgrounds,                      INT)},
@@ -1396,6 +1467,9 @@ uzbl_variables_private_new (GHashTable *table)
         { "ssl_ca_file",                  UZBL_V_FUNC (ssl_ca_file,                            STR)},
         { "ssl_policy",                   UZBL_V_FUNC (ssl_policy,                             STR)},
         { "cache_model",                  UZBL_V_FUNC (cache_model,                            STR)},
+        { "disk_cache_dir",               UZBL_V_FUNC (disk_cache_dir,                         STR)},
+        { "disk_cache_size",              UZBL_V_FUNC (disk_cache_size,                        INT)},
+        { "preconnect_delay",             UZBL_V_FUNC (preconnect_delay,                       INT)},
 
         /* Security variables */
         { "enable_private",               UZBL_V_FUNC (enable_private,                         INT)},
@@ -1404,6 +1478,7 @@ uzbl_variables_private_new (GHashTable *table)
         { "enable_cross_file_access",     UZBL_V_FUNC (enable_cross_file_access,               INT)},
         { "enable_hyperlink_auditing",    UZBL_V_FUNC (enable_hyperlink_auditing,              INT)},
         { "cookie_policy",                UZBL_V_FUNC (cookie_policy,                          STR)},
+        { "shared_cookie_file",           UZBL_V_STRING (priv->shared_cookie_file,             set_shared_cookie_file)},
 #if WEBKIT_CHECK_VERSION (1, 3, 13)
         { "enable_dns_prefetch",          UZBL_V_FUNC (enable_dns_prefetch,                    INT)},
 #endif
@@ -1548,6 +1623,11 @@ uzbl_variables_private_new (GHashTable *table)
         { "plugin_list",                  UZBL_C_FUNC (plugin_list,                            STR)},
 #endif
         { "is_online",                    UZBL_C_FUNC (is_online,                              INT)},
+        { "disk_cache_hits",              UZBL_C_FUNC (disk_cache_hits,                        INT)},
+        { "disk_cache_validations",       UZBL_C_FUNC (disk_cache_validations,                 INT)},
+        { "disk_cache_misses",            UZBL_C_FUNC (disk_cache_misses,                      INT)},
+        { "preconnect_count",             UZBL_C_FUNC (preconnect_count,                       INT)},
+        { "preconnect_hits",              UZBL_C_FUNC (preconnect_hits,                        INT)},
         { "uri",                          UZBL_C_STRING (uzbl.state.uri)},
         { "embedded",                     UZBL_C_INT (uzbl.state.plug_mode)},
         { "WEBKIT_MAJOR",                 UZBL_C_FUNC (WEBKIT_MAJOR,                           INT)},
@@ -1619,9 +1699,8 @@ uzbl_variables_setup_data_manager ()
     {                                         \
         type name;                            \
                                               \
-        g_object_get (G_OBJECT (obj),         \
-            prop, &name,                      \
-            NULL);                            \
+        uzbl_property_cache_get (G_OBJECT (obj),    \
+            prop, &name);                     \
                                               \
         return name;                          \
     }
@@ -1632,9 +1711,8 @@ uzbl_variables_setup_data_manager ()
         type name;                                    \
         rtype rname;                                  \
                                                       \
-        g_object_get (G_OBJECT (obj),                 \
-            prop, &rname,                             \
-            NULL);                                    \
+        uzbl_property_cache_get (G_OBJECT (obj),            \
+            prop, &rname);                            \
         name = rname;                                 \
                                                       \
         return name;                                  \
@@ -2054,6 +2132,50 @@ CHOICE_GETSET (WebKitCacheModel, cache_model,
 
 #undef cache_model_choices
 
+IMPLEMENT_GETTER (gchar *, disk_cache_dir)
+{
+    return g_strdup (uzbl_soup_get_disk_cache_dir ());
+}
+
+IMPLEMENT_SETTER (gchar *, disk_cache_dir)
+{
+    uzbl_soup_set_disk_cache_dir (uzbl.net.soup_session, disk_cache_dir);
+
+    return TRUE;
+}
+
+IMPLEMENT_GETTER (int, disk_cache_size)
+{
+    return uzbl_soup_get_disk_cache_size ();
+}
+
+IMPLEMENT_SETTER (int, disk_cache_size)
+{
+    if (disk_cache_size < 0) {
+        return FALSE;
+    }
+
+    uzbl_soup_set_disk_cache_size (disk_cache_size);
+
+    return TRUE;
+}
+
+IMPLEMENT_GETTER (int, preconnect_delay)
+{
+    return uzbl_soup_get_preconnect_delay ();
+}
+
+IMPLEMENT_SETTER (int, preconnect_delay)
+{
+    if (preconnect_delay < 0) {
+        return FALSE;
+    }
+
+    uzbl_soup_set_preconnect_delay (preconnect_delay);
+
+    return TRUE;
+}
+
 /* Security variables */
 DECLARE_GETSET (int, enable_private_webkit);
 
@@ -2080,6 +2202,12 @@ IMPLEMENT_SETTER (int, enable_private)
         uzbl.net.soup_cookie_jar = uzbl_cookie_jar_new ();
         soup_session_add_feature (uzbl.net.soup_session,
             SOUP_SESSION_FEATURE (uzbl.net.soup_cookie_jar));
+
+        /* Private browsing never shares cookies. */
+        if (!enable_private) {
+            uzbl_cookie_jar_set_shared (uzbl.net.soup_cookie_jar,
+                uzbl.variables->priv->shared_cookie_file);
+        }
     }
 
     set_enable_private_webkit (enable_private);
@@ -2117,6 +2245,18 @@ CHOICE_GETSET (SoupCookieJarAcceptPolicy, cookie_policy,
 
 #undef cookie_policy_choices
 
+IMPLEMENT_SETTER (gchar *, shared_cookie_file)
+{
+    g_free (uzbl.variables->priv->shared_cookie_file);
+    uzbl.variables->priv->shared_cookie_file = g_strdup (shared_cookie_file);
+
+    if (get_enable_private_webkit ()) {
+        return TRUE;
+    }
+
+    return uzbl_cookie_jar_set_shared (uzbl.net.soup_cookie_jar, shared_cookie_file);
+}
+
 #if WEBKIT_CHECK_VERSION (1, 3, 13)
 GOBJECT_GETSET2 (int, enable_dns_prefetch,
                  gboolean, webkit_settings (), "enable-dns-prefetching")
@@ -2779,6 +2919,31 @@ IMPLEMENT_GETTER (int, PID)
     return (int)getpid ();
 }
 
+IMPLEMENT_GETTER (int, disk_cache_hits)
+{
+    return uzbl_soup_get_disk_cache_hits ();
+}
+
+IMPLEMENT_GETTER (int, disk_cache_validations)
+{
+    return uzbl_soup_get_disk_cache_validations ();
+}
+
+IMPLEMENT_GETTER (int, disk_cache_misses)
+{
+    return uzbl_soup_get_disk_cache_misses ();
+}
+
+IMPLEMENT_GETTER (int, preconnect_count)
+{
+    return uzbl_soup_get_preconnect_count ();
+}
+
+IMPLEMENT_GETTER (int, preconnect_hits)
+{
+    return uzbl_soup_get_preconnect_hits ();
+}
+
 GObject *
 webkit_settings ()
 {
@@ -2808,9 +2973,8 @@ object_get (GObject *obj, const gchar *prop)
 {
     int val;
 
-    g_object_get (obj,
-        prop, &val,
-        NULL);
+    uzbl_property_cache_get (obj,
+        prop, &val);
 
     return val;
 }
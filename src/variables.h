@@ -14,6 +14,17 @@ uzbl_variables_toggle (const gchar *name, GArray *values);
 gchar *
 uzbl_variables_expand (const gchar *str);
 
+/* Records what an expansion depended on. */
+typedef struct {
+    /* Whether the result is determined by the inputs and the environment. */
+    gboolean    cacheable;
+    /* Variable name -> value as it was expanded. */
+    GHashTable *inputs;
+} UzblExpandTrace;
+
+gchar *
+uzbl_variables_expand_traced (const gchar *str, UzblExpandTrace *trace);
+
 gchar *
 uzbl_variables_get_string (const gchar *name);
 int
@@ -22,6 +33,8 @@ unsigned long long
 uzbl_variables_get_ull (const gchar *name);
 gdouble
 uzbl_variables_get_double (const gchar *name);
+gchar *
+uzbl_variables_get_expanded (const gchar *name);
 
 void
 uzbl_variables_dump ();
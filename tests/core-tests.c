@@ -4,6 +4,13 @@
 
 #include "../src/setup.h"
 #include "../src/commands.h"
+#include "../src/cookie-jar.h"
+#include "../src/property-cache.h"
+
+#include <glib/gstdio.h>
+
+#include <time.h>
+#include <unistd.h>
 
 UzblCore uzbl;
 
@@ -55,6 +62,53 @@ test_parse_escaped_at ()
     g_assert_cmpstr (g_array_index (argv, gchar*, 0), ==, "@");
 }
 
+static void
+test_cookie_load_tombstone ()
+{
+    gchar *path = NULL;
+    gint fd = g_file_open_tmp ("uzbl-cookies-XXXXXX", &path, NULL);
+    g_assert_cmpint (fd, >=, 0);
+    close (fd);
+
+    /* A cookie and the expired row appended when it was deleted. */
+    gchar *contents = g_strdup_printf (
+        ".example.com\tTRUE\t/\tFALSE\t%ld\tname\tvalue\n"
+        ".example.com\tTRUE\t/\tFALSE\t1\tname\t\n",
+        (long)time (NULL) + 3600);
+    g_assert_true (g_file_set_contents (path, contents, -1, NULL));
+
+    UzblCookieJar *jar = uzbl_cookie_jar_new ();
+    g_assert_cmpint (0, ==, uzbl_cookie_jar_load_text (jar, path, NULL));
+
+    GSList *cookies = soup_cookie_jar_all_cookies (SOUP_COOKIE_JAR (jar));
+    g_assert_null (cookies);
+
+    g_object_unref (jar);
+    g_unlink (path);
+    g_free (contents);
+    g_free (path);
+}
+
+static void
+test_property_cache_notify ()
+{
+    GApplication *app = g_application_new ("org.uzbl.first", G_APPLICATION_FLAGS_NONE);
+    gchar *id = NULL;
+
+    /* Not the canonical spelling of application-id. */
+    uzbl_property_cache_get (G_OBJECT (app), "application_id", &id);
+    g_assert_cmpstr (id, ==, "org.uzbl.first");
+    g_free (id);
+
+    g_application_set_application_id (app, "org.uzbl.second");
+
+    uzbl_property_cache_get (G_OBJECT (app), "application_id", &id);
+    g_assert_cmpstr (id, ==, "org.uzbl.second");
+    g_free (id);
+
+    g_object_unref (app);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -66,6 +120,8 @@ main (int argc, char *argv[])
     g_test_add_func ("/uzbl/commands/parse_quoted", test_parse_quoted);
     g_test_add_func ("/uzbl/commands/parse_extra_whitespace", test_parse_extra_whitespace);
     g_test_add_func ("/uzbl/commands/parse_escaped_at", test_parse_escaped_at);
+    g_test_add_func ("/uzbl/cookies/load_tombstone", test_cookie_load_tombstone);
+    g_test_add_func ("/uzbl/variables/property_cache_notify", test_property_cache_notify);
 
     return g_test_run ();
 }
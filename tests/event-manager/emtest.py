@@ -32,5 +32,11 @@ def add(self):
         self.uzbls[Mock()] = u
         return u
 
+    def publish(self, topic, *args):
+        pass
+
+    def subscribe(self, topic, handler):
+        pass
+
     def get_plugin_config(self, section):
         return self.plugin_config.get(section, {})
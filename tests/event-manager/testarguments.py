@@ -39,3 +39,22 @@ def test_expand_sub_var(self):
     def test_escape(self):
         a = Arguments('foo "\\\\" asd\ af')
         self.assertEquals(a, ('foo', '\\', 'asd af'))
+
+    def test_quoted_words(self):
+        a = Arguments("'example.com' '/' 'a b' plain \"x y\"")
+        self.assertEqual(a, ('example.com', '/', 'a b', 'plain', 'x y'))
+        self.assertEqual(a.raw(2), "'a b' plain \"x y\"")
+        self.assertEqual(a.raw(1, 2), "'/' 'a b'")
+
+    def test_empty_quoted(self):
+        self.assertEqual(Arguments("'' foo"), ('', 'foo'))
+        self.assertEqual(Arguments("foo ''"), ('foo',))
+        self.assertEqual(Arguments("foo '' "), ('foo', ''))
+
+    def test_unclosed_quote(self):
+        a = Arguments("foo 'bar baz")
+        self.assertEqual(a, ('foo', 'bar baz'))
+        self.assertEqual(a.raw(1), "'bar baz")
+
+    def test_trailing_backslash(self):
+        self.assertEqual(Arguments('foo bar\\'), ('foo', 'bar\\'))
@@ -57,3 +57,20 @@ def test_parse_nasty_bind(self):
         self.assertEqual(len(binds), 1)
         self.assertEqual(binds[0].glob, glob)
         self.assertEqual(binds[0].commands, [('do', 'something')])
+
+    def test_candidates_follow_bind_changes(self):
+        b = BindPlugin[self.uzbl]
+        b.mode_bind('global', 'a', justafunction)
+        b.mode_bind('global', '<Ctrl>b', justafunction)
+
+        binds = b.bindlet.get_candidates(False, False)
+        self.assertEqual([bind.glob for (bind, t) in binds], ['a'])
+
+        b.mode_bind('global', 'c', justafunction)
+        b.mode_bind('global,-command', 'a', justafunction)
+        binds = b.bindlet.get_candidates(False, False)
+        self.assertEqual([bind.glob for (bind, t) in binds], ['a', 'c'])
+
+        Config[self.uzbl].parse_set_event('mode str command')
+        binds = b.bindlet.get_candidates(False, False)
+        self.assertEqual([bind.glob for (bind, t) in binds], ['c'])
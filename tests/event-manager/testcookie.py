@@ -5,10 +5,15 @@
 if '' not in sys.path:
     sys.path.insert(0, '')
 
+import os
+import shutil
+import tempfile
 import unittest
+from multiprocessing import Process
 from emtest import EventManagerMock
 
-from uzbl.plugins.cookies import Cookies
+from uzbl.arguments import splitquoted
+from uzbl.plugins.cookies import Cookies, CookieMatcher, TextStore
 from uzbl.plugins.config import Config
 
 cookies = (
@@ -73,6 +78,61 @@ def test_filter_numeric(self):
             'cookie delete ' + cookies[1])
 
 
+class CookieMatcherTest(unittest.TestCase):
+    def cookie(self, domain, name='n', path='/'):
+        return (domain, path, name, 'v', 'http', '')
+
+    def test_empty(self):
+        m = CookieMatcher()
+        self.assertFalse(m)
+        self.assertFalse(m.match(self.cookie('example.com')))
+
+    def test_domain_suffix(self):
+        m = CookieMatcher()
+        m.add(r'domain "example\\.com$"')
+        self.assertTrue(m.match(self.cookie('example.com')))
+        self.assertTrue(m.match(self.cookie('.www.example.com')))
+        self.assertTrue(m.match(self.cookie('badexample.com')))
+        self.assertFalse(m.match(self.cookie('example.com.au')))
+
+    def test_domain_exact(self):
+        m = CookieMatcher()
+        m.add(r'domain "^example\\.com$"')
+        self.assertTrue(m.match(self.cookie('example.com')))
+        self.assertFalse(m.match(self.cookie('www.example.com')))
+
+    def test_domain_label(self):
+        m = CookieMatcher()
+        m.add(r'domain "(^|\\.)example\\.com$"')
+        self.assertTrue(m.match(self.cookie('example.com')))
+        self.assertTrue(m.match(self.cookie('.example.com')))
+        self.assertFalse(m.match(self.cookie('badexample.com')))
+
+    def test_merged(self):
+        m = CookieMatcher()
+        m.add(r'name "^__utm"')
+        m.add(r'name "^_ga$"')
+        m.add(r'domain "doubleclick"')
+        self.assertTrue(m.match(self.cookie('a.com', name='__utmb')))
+        self.assertTrue(m.match(self.cookie('a.com', name='_ga')))
+        self.assertTrue(m.match(self.cookie('ad.doubleclick.net')))
+        self.assertFalse(m.match(self.cookie('a.com', name='_gat')))
+
+    def test_multi_component(self):
+        m = CookieMatcher()
+        m.add(r'domain "example\\.com$" name "^session$"')
+        self.assertTrue(m.match(self.cookie('example.com', name='session')))
+        self.assertFalse(m.match(self.cookie('example.com', name='other')))
+        self.assertFalse(m.match(self.cookie('other.com', name='session')))
+
+    def test_add_after_match(self):
+        m = CookieMatcher()
+        m.add(r'domain "example\\.com$"')
+        self.assertFalse(m.match(self.cookie('other.com')))
+        m.add(r'domain "other\\.com$"')
+        self.assertTrue(m.match(self.cookie('other.com')))
+
+
 class PrivateCookieTest(unittest.TestCase):
     def setUp(self):
         self.event_manager = EventManagerMock(
@@ -99,5 +159,141 @@ def test_does_not_send_to_private_uzbl(self):
         self.priv.send.assert_not_called()
 
 
+class SharedCookieTest(unittest.TestCase):
+    def setUp(self):
+        self.event_manager = EventManagerMock(
+            (), (Cookies,),
+            (), ((Config, dict),),
+            config
+        )
+        self.uzbl_a = self.event_manager.add()
+        self.uzbl_b = self.event_manager.add()
+        self.uzbl_c = self.event_manager.add()
+
+        Config[self.uzbl_a]['shared_cookie_file'] = '/tmp/cookies'
+        Config[self.uzbl_b]['shared_cookie_file'] = '/tmp/cookies'
+
+    def test_does_not_send_to_sharing_uzbl(self):
+        c = Cookies[self.uzbl_a]
+        c.add_cookie(cookies[0])
+        self.uzbl_b.send.assert_not_called()
+        self.uzbl_c.send.assert_called_once_with(
+            'cookie add ' + cookies[0])
+
+    def test_sends_to_sharing_uzbl_from_unshared(self):
+        c = Cookies[self.uzbl_c]
+        c.add_cookie(cookies[0])
+        self.uzbl_a.send.assert_called_once_with(
+            'cookie add ' + cookies[0])
+        self.uzbl_b.send.assert_called_once_with(
+            'cookie add ' + cookies[0])
+
+
+class TextStoreTest(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.filename = os.path.join(self.dir, 'cookies.txt')
+        self.stores = []
+        self.store = self.open_store()
+
+    def tearDown(self):
+        for store in self.stores:
+            store.close()
+        shutil.rmtree(self.dir)
+
+    def open_store(self):
+        store = TextStore(self.filename)
+        self.stores.append(store)
+        return store
+
+    def add(self, store, raw):
+        cookie = splitquoted(raw)
+        store.add_cookie(cookie.raw(), cookie)
+
+    def live(self):
+        # read the file back the way a loader replaying it in order would
+        store = self.open_store()
+        store.load()
+        return sorted(store.index.values())
+
+    def test_add_appends(self):
+        self.add(self.store, cookies[0])
+        self.add(self.store, cookies[1])
+        with open(self.filename) as f:
+            lines = f.readlines()
+        self.assertEqual(len(lines), 3)
+        self.assertEqual(len(self.live()), 2)
+
+    def test_replace(self):
+        self.add(self.store, cookies[0])
+        self.add(self.store, cookies[0].replace('183192761', '42'))
+        live = self.live()
+        self.assertEqual(len(live), 1)
+        self.assertEqual(live[0][6], '42.1.10.1313990640')
+
+    def test_delete(self):
+        self.add(self.store, cookies[0])
+        self.add(self.store, cookies[1])
+        key = splitquoted(cookies[0])
+        self.store.delete_cookie(key.raw(), key)
+        live = self.live()
+        self.assertEqual(len(live), 1)
+        self.assertEqual(live[0][0], '.twitter.com')
+
+    def test_delete_mismatch(self):
+        self.add(self.store, cookies[0])
+        key = splitquoted(cookies[0].replace('183192761', '42'))
+        self.store.delete_cookie(key.raw(), key)
+        self.assertEqual(len(self.live()), 1)
+
+    def test_external_change(self):
+        self.add(self.store, cookies[0])
+        other = self.open_store()
+        self.add(other, cookies[1])
+        key = splitquoted(cookies[1])
+        self.store.delete_cookie(key.raw(), key)
+        self.assertEqual(len(self.live()), 1)
+
+    def test_compact(self):
+        self.store.COMPACT_THRESHOLD = 4
+        for i in range(10):
+            self.add(self.store, cookies[0].replace('183192761', str(i)))
+        with open(self.filename) as f:
+            lines = f.readlines()
+        self.assertLess(len(lines), 7)
+        live = self.live()
+        self.assertEqual(len(live), 1)
+        self.assertEqual(live[0][6], '9.1.10.1313990640')
+
+    def test_reads_only_appended(self):
+        self.add(self.store, cookies[0])
+        other = self.open_store()
+        self.add(other, cookies[1])
+
+        # a full read would find the cookie which was overwritten in place
+        with open(self.filename, 'r+') as f:
+            f.write('#' * len(f.readline().rstrip('\n')))
+        self.store.load()
+        self.assertEqual(len(self.store.index), 2)
+
+    def test_concurrent_writers(self):
+        def write(n):
+            store = TextStore(self.filename)
+            store.COMPACT_THRESHOLD = 5
+            for i in range(300):
+                self.add(store, cookies[0].replace('__utmb', 'c%d_%d' % (n, i % 20)))
+            store.close()
+
+        writers = [Process(target=write, args=(n,)) for n in range(4)]
+        for p in writers:
+            p.start()
+        for p in writers:
+            p.join()
+
+        self.assertEqual(len(self.live()), 80)
+        self.assertEqual(sorted(os.listdir(self.dir)),
+                         ['cookies.txt', 'cookies.txt.lock'])
+
+
 if __name__ == '__main__':
     unittest.main()
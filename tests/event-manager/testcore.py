@@ -1,10 +1,13 @@
 #!/usr/bin/env python
 # vi: set et ts=4:
 
+import json
 import six
+import time
 import unittest
+from collections import defaultdict
 from mock import Mock
-from uzbl.core import Uzbl
+from uzbl.core import FinalResponse, Timing, Uzbl
 
 
 class TestUzbl(unittest.TestCase):
@@ -87,3 +90,105 @@ def __init__(self, uzbl): pass
         for t in (FooPlugin, BarPlugin):
             self.assertIn(t, u.plugins)
             self.assertTrue(isinstance(u.plugins[t], t))
+
+    def test_request_runs_handlers_by_priority(self):
+        first = Mock(side_effect=lambda r, *a, **k: ('first', a, k))
+        second = Mock(return_value=('second', (), {}))
+        self.uzbl.answer_request('FOO', 2, second)
+        self.uzbl.answer_request('FOO', 1, first)
+        self.uzbl.parse_msg('REQUEST-12 spam FOO bar')
+        second.assert_called_once_with('first', 'bar', cookie='12')
+        self.proto.push.assert_called_once_with(b'REPLY-12 second\n')
+
+    def test_final_response_skips_other_handlers(self):
+        first = Mock(return_value=(FinalResponse('first'), (), {}))
+        second = Mock(return_value=('second', (), {}))
+        self.uzbl.answer_request('FOO', 1, first)
+        self.uzbl.answer_request('FOO', 2, second)
+        self.uzbl.parse_msg('REQUEST-12 spam FOO')
+        self.assertFalse(second.called)
+        self.proto.push.assert_called_once_with(b'REPLY-12 first\n')
+
+    def test_request_over_budget_sends_default(self):
+        def slow(response, *args, **kargs):
+            time.sleep(0.02)
+            return ('slow', args, kargs)
+        second = Mock(return_value=('second', (), {}))
+        self.uzbl.answer_request('FOO', 1, slow)
+        self.uzbl.answer_request('FOO', 2, second)
+        self.uzbl.request_budget('FOO', 0.01, 'late')
+        self.uzbl.parse_msg('REQUEST-12 spam FOO')
+        self.assertFalse(second.called)
+        self.proto.push.assert_called_once_with(b'REPLY-12 late\n')
+        self.assertEqual(self.uzbl.request_stats['FOO'].over_budget, 1)
+
+    def test_request_over_budget_keeps_complete_answer(self):
+        def slow(response, *args, **kargs):
+            time.sleep(0.02)
+            return ('slow', args, kargs)
+        self.uzbl.answer_request('FOO', 1, slow)
+        self.uzbl.request_budget('FOO', 0.01, 'late')
+        self.uzbl.parse_msg('REQUEST-12 spam FOO')
+        self.proto.push.assert_called_once_with(b'REPLY-12 slow\n')
+        self.assertEqual(self.uzbl.request_stats['FOO'].over_budget, 1)
+
+    def test_slow_final_response_counts_over_budget(self):
+        def slow(response, *args, **kargs):
+            time.sleep(0.02)
+            return (FinalResponse('slow'), args, kargs)
+        second = Mock(return_value=('second', (), {}))
+        self.uzbl.answer_request('FOO', 1, slow)
+        self.uzbl.answer_request('FOO', 2, second)
+        self.uzbl.request_budget('FOO', 0.01, 'late')
+        self.uzbl.parse_msg('REQUEST-12 spam FOO')
+        self.assertFalse(second.called)
+        self.proto.push.assert_called_once_with(b'REPLY-12 slow\n')
+        self.assertEqual(self.uzbl.request_stats['FOO'].over_budget, 1)
+
+    def test_profile_times_handlers(self):
+        profile = defaultdict(Timing)
+        uzbl = Uzbl(self.em, self.proto, False, profile)
+        handler = Mock(__qualname__='Plugin.handler')
+        uzbl.connect('FOO', handler)
+        uzbl.event('FOO', 'a')
+        uzbl.event('FOO', 'b')
+        self.assertEqual(profile[('FOO', 'Plugin.handler')].count, 2)
+
+        uzbl.parse_msg('REQUEST-3 spam EM_STATS')
+        reply = self.proto.push.call_args[0][0].decode('utf-8')
+        self.assertTrue(reply.startswith('REPLY-3 '))
+        stats = json.loads(reply[len('REPLY-3 '):])
+        self.assertEqual([(s['event'], s['handler'], s['count']) for s in stats],
+                         [('FOO', 'Plugin.handler', 2)])
+
+    def test_plugin_created_on_its_first_event(self):
+        calls = []
+        class EagerPlugin(object):
+            def __init__(self, uzbl):
+                uzbl.connect('FOO', lambda: calls.append('eager'))
+        class LazyPlugin(object):
+            EVENTS = ('FOO',)
+            def __init__(self, uzbl):
+                uzbl.connect('FOO', lambda: calls.append('lazy'))
+        class UnusedPlugin(object):
+            EVENTS = ('BAR',)
+        self.em.plugind.per_instance_plugins = [LazyPlugin, EagerPlugin, UnusedPlugin]
+        u = self.uzbl
+        u.init_plugins()
+        u.connect('FOO', lambda: calls.append('late'))
+        self.assertEqual(list(u.plugins), [EagerPlugin])
+
+        u.event('FOO')
+        self.assertIn(LazyPlugin, u.plugins)
+        self.assertNotIn(UnusedPlugin, u.plugins)
+        # Handlers keep the plugin order whenever the plugin was created.
+        self.assertEqual(calls, ['lazy', 'eager', 'late'])
+
+    def test_plugin_created_on_lookup(self):
+        class LazyPlugin(object):
+            EVENTS = ('BAR',)
+            def __init__(self, uzbl): pass
+        self.em.plugind.per_instance_plugins = [LazyPlugin]
+        self.uzbl.init_plugins()
+        self.assertTrue(isinstance(self.uzbl.plugins[LazyPlugin], LazyPlugin))
+        self.assertRaises(KeyError, lambda: self.uzbl.plugins[Uzbl])
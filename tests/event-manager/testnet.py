@@ -0,0 +1,51 @@
+#!/usr/bin/env python
+# vi: set et ts=4:
+
+import asyncio
+import unittest
+from mock import Mock
+from uzbl import net
+
+
+class TestProtocol(unittest.TestCase):
+    def setUp(self):
+        self.loop = asyncio.new_event_loop()
+        self.reader = asyncio.StreamReader(loop=self.loop)
+        self.target = Mock()
+        self.proto = net.Protocol(self.reader, Mock(), self.target)
+
+    def tearDown(self):
+        self.loop.close()
+
+    def run_with(self, *chunks):
+        for chunk in chunks:
+            self.reader.feed_data(chunk)
+        self.reader.feed_eof()
+        self.loop.run_until_complete(self.proto.run())
+        return [c[0][0] for c in self.target.parse_msg.call_args_list]
+
+    def test_lines_in_one_chunk(self):
+        lines = self.run_with(b'EVENT [a] FOO\nEVENT [a] BAR x\n')
+        self.assertEqual(lines, ['EVENT [a] FOO', 'EVENT [a] BAR x'])
+
+    def test_line_split_across_chunks(self):
+        lines = self.run_with(b'EVENT [a] F', b'OO\nEVENT', b' [a] BAR\n')
+        self.assertEqual(lines, ['EVENT [a] FOO', 'EVENT [a] BAR'])
+
+    def test_unterminated_line_is_dropped(self):
+        lines = self.run_with(b'EVENT [a] FOO\nEVENT [a] BA')
+        self.assertEqual(lines, ['EVENT [a] FOO'])
+
+    def test_invalid_utf8_only_drops_its_line(self):
+        lines = self.run_with(b'EVENT [a] FOO\n\xff\nEVENT [a] \xc3\xa9\n')
+        self.assertEqual(lines, ['EVENT [a] FOO', 'EVENT [a] \xe9'])
+
+    def test_overlong_line_is_dropped(self):
+        big = b'x' * (net.READ_LIMIT + 1)
+        lines = self.run_with(big, big, b'x\nEVENT [a] FOO\n')
+        self.assertEqual(lines, ['EVENT [a] FOO'])
+
+    def test_invalid_message_does_not_stop_reading(self):
+        self.target.parse_msg.side_effect = [ValueError('bad'), None]
+        lines = self.run_with(b'EVENT\nEVENT [a] FOO\n')
+        self.assertEqual(lines, ['EVENT', 'EVENT [a] FOO'])
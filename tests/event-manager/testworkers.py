@@ -0,0 +1,99 @@
+#!/usr/bin/env python
+# vi: set et ts=4:
+
+import os
+import shutil
+import socket
+import tempfile
+import time
+import unittest
+from multiprocessing import Process
+
+from uzbl.workers import WorkerPool
+
+
+class Echo(object):
+    '''Tells the instances of other workers what an instance SAYs.'''
+
+    def __init__(self, event_manager):
+        self.event_manager = event_manager
+        event_manager.subscribe('said', self.heard)
+
+    def new_uzbl(self, uzbl):
+        uzbl.connect('SAY', self.say)
+        uzbl.send('welcome')
+
+    def free_uzbl(self, uzbl):
+        pass
+
+    def say(self, text):
+        self.event_manager.publish('said', text)
+
+    def heard(self, text):
+        for uzbl in self.event_manager.uzbls.values():
+            uzbl.send('heard %s' % text)
+
+    def cleanup(self):
+        del self.event_manager
+
+
+class EchoPluginDirectory(object):
+    def __init__(self):
+        self.global_plugins = []
+        self.per_instance_plugins = []
+
+    def load(self):
+        self.global_plugins.append(Echo)
+
+
+def run_pool(path):
+    pool = WorkerPool(EchoPluginDirectory(), {}, path, 2, auto_close=True)
+    pool.listen()
+    pool.run()
+
+
+class TestWorkerPool(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.path = os.path.join(self.dir, 'event_daemon')
+        self.pool = Process(target=run_pool, args=(self.path,))
+        self.pool.start()
+
+        for i in range(100):
+            if os.path.exists(self.path):
+                break
+            time.sleep(0.05)
+
+    def tearDown(self):
+        self.pool.join(10)
+        if self.pool.is_alive():
+            self.pool.terminate()
+        shutil.rmtree(self.dir)
+
+    def connect(self):
+        sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        sock.settimeout(10)
+        sock.connect(self.path)
+        return sock
+
+    def test_publish_reaches_other_worker(self):
+        a = self.connect()
+        b = self.connect()
+        # What is published before an instance is served never reaches it.
+        self.assertEqual(a.recv(100), b'welcome\n')
+        self.assertEqual(b.recv(100), b'welcome\n')
+        a.sendall(b'EVENT [a] INSTANCE_START 1\n')
+        b.sendall(b'EVENT [b] INSTANCE_START 2\n')
+
+        a.sendall(b'EVENT [a] SAY hello\n')
+        self.assertEqual(b.recv(100), b'heard hello\n')
+
+        a.sendall(b'EVENT [a] INSTANCE_EXIT\n')
+        b.sendall(b'EVENT [b] INSTANCE_EXIT\n')
+        a.close()
+        b.close()
+
+        # auto_close shuts everything down once both instances are gone.
+        self.pool.join(10)
+        self.assertEqual(self.pool.exitcode, 0)
+        self.assertFalse(os.path.exists(self.path))
@@ -6,74 +6,98 @@
 
 import re
 
-sglquote = re.compile("^'")
-dblquote = re.compile('^"')
-exp = re.compile('^(@[({<*/-]|[)}>*/-]@)')
-space = re.compile('^\\s+')
-escape = re.compile('^\\\\.')
-str = re.compile('^[^\'"\\s@<>\\\\]+')
-special = re.compile('^[@<>]')
+# One alternative per token type, tried in this order at every position.
+# A backslash which escapes nothing (at the end of the input) is kept as is.
+token = re.compile('|'.join([
+    "(?P<sglquote>')",
+    '(?P<dblquote>")',
+    '(?P<exp>@[({<*/-]|[)}>*/-]@)',
+    '(?P<space>\\s+)',
+    '(?P<escape>\\\\.)',
+    '(?P<text>[^\'"\\s@<>\\\\]+)',
+    '(?P<special>[@<>\\\\])',
+]))
+
+space = re.compile('\\s+')
+
+# Lines made only of plain words and wholly quoted strings without escapes
+# are what almost every event sends (uzbl quotes each string argument). Such
+# lines are split without looking at single tokens.
+simple_line = re.compile('\\s*(?:(?:\'[^\']*\'|"[^"]*"|[^\'"\\s@<>\\\\]+)(?:\\s+|\\Z))*')
+simple_arg = re.compile('\'([^\']*)\'|"([^"]*)"|([^\'"\\s@<>\\\\]+)')
+
+
+def split(s):
+    '''
+    Splits s into its arguments. Where they are in s is only worked out
+    (by parse) when asked for, so this returns None for it unless s has to
+    be parsed token by token anyway.
+    '''
+    if '\\' in s or not simple_line.fullmatch(s):
+        return parse(s)
 
-patterns = (sglquote, dblquote, exp, space, escape, str, special)
+    args = [sgl or dbl or word for sgl, dbl, word in simple_arg.findall(s)]
+    # An empty last argument ('') is dropped
+    if args and not args[-1] and not s[-1].isspace():
+        args.pop()
+    return args, None
 
 
-def match(s):
-    for p in patterns:
-        m = p.search(s)
+def parse(s):
+    '''
+    Splits s in a single pass over its tokens. Returns the arguments and,
+    for each of them, where it starts and ends in s.
+    '''
+    args = []
+    ref = []
+    pos, end = 0, len(s)
+    while pos < end:
+        m = space.match(s, pos)
         if m:
-            return p, m
-
+            pos = m.end()
+            if pos == end:
+                break
 
-def lex(s):
-    i, l = 0, len(s)
-    while i < l:
-        p, m = match(s[i:])
-        i += m.end()
-        yield p, m.group(0)
+        arg, stop = parse_arg(s, pos)
+        # An empty last argument ('') is dropped
+        if arg or stop < end:
+            args.append(arg)
+            ref.append((pos, stop))
+        pos = stop
+    return args, ref
 
 
-def parse(l):
-    raw = []
-    ref = []
-    args = []
-    s = ''
+def parse_arg(s, pos):
+    '''
+    Splits off the argument starting at pos token by token. Returns it and
+    the position of the whitespace (or end of s) which ends it.
+    '''
+    arg = ''
     close = None
-    start = None
-    for i, (p, t) in enumerate(l):
-        raw.append(t)
+    for m in token.finditer(s, pos):
+        kind = m.lastgroup
+        t = m.group()
         if close:
-            if p is close:
-                if p is exp:
-                    s += t
+            if kind == close:
+                if kind == 'exp':
+                    arg += t
                 close = None
-            elif p is escape:
-                s += t[1:]
+            elif kind == 'escape':
+                arg += t[1:]
             else:
-                s += t
+                arg += t
+        elif kind == 'space':
+            return arg, m.start()
+        elif kind == 'sglquote' or kind == 'dblquote':
+            close = kind
+        elif kind == 'exp':
+            close = kind
+            arg += t
+        elif kind == 'escape':
+            arg += t[1:]
         else:
-            if p is space:
-                if start is not None:
-                    ref.append(start)
-                    args.append(s)
-                s = ''
-                start = None
-                continue
-            elif start is None:
-                start = i
-
-            if p in (sglquote, dblquote):
-                close = p
-            elif p is exp:
-                close = p
-                s += t
-            elif p is escape:
-                s += t[1:]
-            else:
-                s += t
-    if s:
-        ref.append(start)
-        args.append(s)
-    return args, raw, ref
+            arg += t
+    return arg, len(s)
 
 
 class Arguments(tuple):
@@ -95,12 +119,20 @@ def __new__(cls, s):
         >>> Arguments(('foo', 'bar', 'baz az'))
         ('foo', 'bar', 'baz az')
         '''
+        if isinstance(s, RawArguments):
+            return s.arguments()
+
         if isinstance(s, tuple):
             self = tuple.__new__(cls, s)
-            self._raw, self._ref = s, list(range(len(s)))
+            self._raw, self._ref = ''.join(s), []
+            pos = 0
+            for arg in s:
+                self._ref.append((pos, pos))
+                pos += len(arg)
             return self
 
-        args, raw, ref = parse(lex(s))
+        args, ref = split(s)
+        raw = s
         self = tuple.__new__(cls, args)
         self._raw, self._ref = raw, ref
         return self
@@ -116,14 +148,16 @@ def raw(self, frm=0, to=None):
         >>> args.raw(1)
         "egg sausage   and 'spam'"
         '''
+        if self._ref is None:
+            self._ref = parse(self._raw)[1]
         if len(self._ref) < 1:
             return ''
-        rfrm = self._ref[frm]
+        rfrm = self._ref[frm][0]
         if to is None or len(self._ref) <= to + 1:
             rto = len(self._raw)
         else:
-            rto = self._ref[to + 1] - 1
-        return ''.join(self._raw[rfrm:rto])
+            rto = self._ref[to][1]
+        return self._raw[rfrm:rto]
 
     def safe_raw(self, frm=0, to=None):
         '''
@@ -141,6 +175,26 @@ def safe_raw(self, frm=0, to=None):
 splitquoted = Arguments  # or define a function?
 
 
+class RawArguments(str):
+    '''
+    The argument string of a single event. It is shared by every handler of
+    the event and split at most once, when a handler first asks for it.
+
+    >>> s = RawArguments(r"spam 'egg sausage'")
+    >>> splitquoted(s)
+    ('spam', 'egg sausage')
+    >>> splitquoted(s) is splitquoted(s)
+    True
+    '''
+
+    def arguments(self):
+        try:
+            return self._arguments
+        except AttributeError:
+            self._arguments = Arguments(str(self))
+            return self._arguments
+
+
 def is_quoted(s):
     return s and s[0] == s[-1] and s[0] in "'\""
 
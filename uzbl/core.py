@@ -1,11 +1,102 @@
+import sys
 import time
+import json
 import logging
+from bisect import bisect_right
 from collections import defaultdict
+from functools import partial
+from uzbl.arguments import RawArguments
+
+
+# Upper-cased and interned event names, keyed by the name as sent.
+_event_names = {}
+
+# Seconds the handlers of a request may take in total. uzbl gives up on a
+# request after one second, so the default reply has to be sent well before.
+REQUEST_BUDGET = 0.5
+
+
+def event_name(name):
+    '''Return the canonical form of an event name.'''
+    try:
+        return _event_names[name]
+    except KeyError:
+        canonical = _event_names[name] = sys.intern(name.upper())
+        return canonical
+
+
+class FinalResponse(object):
+    '''Returned by a request handler in place of its response to answer the
+    request right away, without running the lower priority handlers.'''
+
+    def __init__(self, response):
+        self.response = response
+
+
+class Timing(object):
+    '''Number, total and longest wall time of calls.'''
+
+    def __init__(self):
+        self.count = 0
+        self.total = 0.0
+        self.max = 0.0
+
+    def record(self, elapsed):
+        self.count += 1
+        self.total += elapsed
+        self.max = max(self.max, elapsed)
+
+
+class RequestStats(Timing):
+    '''Latency of the requests of one name.'''
+
+    def __init__(self):
+        super(RequestStats, self).__init__()
+        self.over_budget = 0
+
+    def record(self, elapsed, over_budget):
+        super(RequestStats, self).record(elapsed)
+        if over_budget:
+            self.over_budget += 1
+
+    def __repr__(self):
+        return '%d answered, mean %.2fms, max %.2fms, %d over budget' % (
+            self.count, self.total / self.count * 1000, self.max * 1000,
+            self.over_budget)
+
+
+def handler_name(handler):
+    '''Name a handler after the function (or method) it calls.'''
+    while isinstance(handler, partial):
+        handler = handler.func
+    return getattr(handler, '__qualname__', None) or repr(handler)
+
+
+def profile_report(profile):
+    '''Return the timings of a handler profile as a list of dicts, the
+    handlers which took the longest in total first.'''
+
+    return [{'event': event, 'handler': handler, 'count': t.count,
+             'total': t.total, 'max': t.max}
+            for ((event, handler), t) in sorted(
+                profile.items(), key=lambda item: item[1].total, reverse=True)]
+
+
+class PluginInstances(dict):
+    '''The plugin instances of an uzbl instance. A plugin which hasn't been
+    created yet is created when it is first looked up.'''
+
+    def __init__(self, load):
+        super(PluginInstances, self).__init__()
+        self.load = load
+
+    def __missing__(self, plugin):
+        return self.load(plugin)
 
 
 class Uzbl(object):
 
-    def __init__(self, parent, proto, print_events=False):
+    def __init__(self, parent, proto, print_events=False, profile=None):
         proto.target = self
         self.print_events = print_events
         self.parent = parent
@@ -22,12 +113,34 @@ def __init__(self, parent, proto, print_events=False):
 
         # Plugin instances
         self._plugin_instances = []
-        self.plugins = {}
-
-        # Track plugin event handlers
+        self.plugins = PluginInstances(self.load_plugin)
+
+        # Per-instance plugins not created yet, with their place in the
+        # plugin order, and the plugins waiting for each event or request.
+        # {plugin: rank, ..}
+        # {event name or 'REQUEST <name>': [plugin, ..], ..}
+        self._pending = {}
+        self._triggers = {}
+        self._rank = None
+
+        # Track plugin event handlers, each list in the order of the
+        # plugins which connected them (see connect).
         self.handlers = defaultdict(list)
+        self._handler_ranks = defaultdict(list)
         self.request_handlers = defaultdict(list)
 
+        # Time budget and default reply of requests
+        # {request name: (budget, default), ..}
+        self.request_budgets = {}
+        self.request_stats = defaultdict(RequestStats)
+
+        # The timings of the handlers, shared by all instances of the
+        # event manager, or None when handlers aren't timed.
+        # {(event name, handler name): Timing, ..}
+        self.profile = profile
+        self._handler_names = {}
+        self.answer_request('EM_STATS', 0, self.em_stats)
+
         # Internal vars
         self._depth = 0
         self._buffer = ''
@@ -41,12 +154,42 @@ def __repr__(self):
             '%d request handlers' % sum([len(l) for l in list(self.request_handlers.values())])])
 
     def init_plugins(self):
-        '''Creates instances of per-instance plugins'''
-
-        for plugin in self.parent.plugind.per_instance_plugins:
+        '''Creates instances of per-instance plugins, leaving those which
+        declare their events until one of them arrives.'''
+
+        plugins = self.parent.plugind.per_instance_plugins
+        for (rank, plugin) in enumerate(plugins):
+            self._pending[plugin] = rank
+            events = getattr(plugin, 'EVENTS', None)
+            if events is None:
+                continue
+            requests = ['REQUEST %s' % name for name in getattr(plugin, 'REQUESTS', ())]
+            for name in list(events) + requests:
+                self._triggers.setdefault(name, []).append(plugin)
+
+        for plugin in plugins:
+            if getattr(plugin, 'EVENTS', None) is None and plugin in self._pending:
+                self.load_plugin(plugin)
+
+    def load_plugin(self, plugin):
+        '''Create a pending per-instance plugin. Raises KeyError for any
+        other plugin.'''
+
+        rank = self._pending.pop(plugin)
+        outer, self._rank = self._rank, rank
+        try:
             pinst = plugin(self)
-            self._plugin_instances.append(pinst)
-            self.plugins[plugin] = pinst
+        finally:
+            self._rank = outer
+
+        self._plugin_instances.append(pinst)
+        self.plugins[plugin] = pinst
+        return pinst
+
+    def load_plugins_for(self, name):
+        for plugin in self._triggers.pop(name):
+            if plugin in self._pending:
+                self.load_plugin(plugin)
 
     def send(self, msg):
         '''Send a command to the uzbl instance via the child socket
@@ -104,8 +247,9 @@ def parse_msg(self, line):
                 (self.name, name)
             )
 
-        # Handle the event with the event handlers through the event method
-        handler(event, args, **kargs)
+        # Handle the event with the event handlers through the event method.
+        # The handlers share the argument string and so its split form.
+        handler(event, RawArguments(args), **kargs)
 
     def request(self, request, *args, **kargs):
         '''Complete a request.'''
@@ -126,28 +270,52 @@ def request(self, request, *args, **kargs):
                 elems.append(str(kargs))
             self.logger.debug(('%s-?> %s %s' % ('  ' * self._depth, cookie, ' '.join(elems))))
 
+        if 'REQUEST ' + request in self._triggers:
+            self.load_plugins_for('REQUEST ' + request)
+
         final_response = None
+        budget, default = self.request_budgets.get(request, (REQUEST_BUDGET, ''))
+        start = time.monotonic()
+
+        profile = self.profile
+        handlers = self.request_handlers.get(request, ())
+        for (i, (prio, handler)) in enumerate(handlers, 1):
+            self._depth += 1
+            began = time.perf_counter()
+            try:
+                (response, args, kargs) = handler(final_response, *args, **kargs)
+            except BaseException:
+                self.logger.error('error in request handler for \'%s\'', request, exc_info=True)
+                response = None
+            if profile is not None:
+                self.record_handler('REQUEST ' + request, handler, time.perf_counter() - began)
+            self._depth -= 1
 
-        if request in self.request_handlers:
-            for (prio, handler) in self.request_handlers[request]:
-                self._depth += 1
-                try:
-                    (response, args, kargs) = handler(final_response, *args, **kargs)
-                    if response is not None:
-                        final_response = response
-                except BaseException:
-                    self.logger.error('error in request handler for \'%s\'', request, exc_info=True)
-                self._depth -= 1
+            if isinstance(response, FinalResponse):
+                final_response = response.response
+                break
+            if response is not None:
+                final_response = response
+
+            # A handler can't be interrupted, but the ones after it are
+            # skipped once the budget is spent.
+            if i < len(handlers) and time.monotonic() - start > budget:
+                self.logger.warning('request \'%s\' over its %.3fs budget after %r',
+                                    request, budget, handler)
+                final_response = None
+                break
 
         if final_response is None:
-            final_response = ''
+            final_response = default
 
         self.reply(cookie, final_response)
+        elapsed = time.monotonic() - start
+        self.request_stats[request].record(elapsed, elapsed > budget)
 
     def event(self, event, *args, **kargs):
         '''Raise an event.'''
 
-        event = event.upper()
+        event = event_name(event)
 
         if self.print_events:
             elems = [event]
@@ -169,19 +337,44 @@ def event(self, event, *args, **kargs):
             self.logger.info('uzbl instance exit')
             self.close()
 
-        if event not in self.handlers:
+        if event in self._triggers:
+            self.load_plugins_for(event)
+
+        handlers = self.handlers.get(event)
+        if not handlers:
             return
 
-        for handler in self.handlers[event]:
+        profile = self.profile
+        for handler in handlers:
             self._depth += 1
+            if profile is not None:
+                began = time.perf_counter()
             try:
                 handler(*args, **kargs)
 
             except BaseException:
                 self.logger.error('error in handler for \'%s\'', event, exc_info=True)
 
+            if profile is not None:
+                self.record_handler(event, handler, time.perf_counter() - began)
             self._depth -= 1
 
+    def record_handler(self, event, handler, elapsed):
+        '''Add a call of handler to the profile. The time includes the
+        handlers of any events it raised.'''
+
+        try:
+            name = self._handler_names[handler]
+        except KeyError:
+            name = self._handler_names[handler] = handler_name(handler)
+        self.profile[(event, name)].record(elapsed)
+
+    def em_stats(self, response, *args, **kargs):
+        '''Answer the EM_STATS request with the handler profile as JSON.'''
+
+        report = profile_report(self.profile) if self.profile is not None else []
+        return (json.dumps(report), args, kargs)
+
     def close_connection(self, child_socket):
         '''Close child socket and delete the uzbl instance created for that
         child socket connection.'''
@@ -196,11 +389,16 @@ def close(self):
         self.logger.debug('removing self from uzbls list')
         self.parent.remove_instance(self.proto.socket)
 
+        self._pending.clear()
+        self._triggers.clear()
         for plugin in self._plugin_instances:
             plugin.cleanup()
         del self.plugins  # to avoid cyclic links
         del self._plugin_instances
 
+        for (request, stats) in sorted(self.request_stats.items()):
+            self.logger.info('request %s: %r', request, stats)
+
         self.logger.info('removed %r', self)
 
     def connect(self, name, handler):
@@ -208,14 +406,25 @@ def connect(self, name, handler):
 
         No extra arguments added. Use bound methods and partials to have
         extra arguments.
+
+        Handlers connected while a plugin is created run in the order of the
+        plugins, however late the plugin was created, and before the
+        handlers connected at any other time.
         """
-        self.handlers[name].append(handler)
+        rank = self._rank if self._rank is not None else float('inf')
+        ranks = self._handler_ranks[name]
+        index = bisect_right(ranks, rank)
+        ranks.insert(index, rank)
+        self.handlers[name].insert(index, handler)
 
     def answer_request(self, name, prio, handler):
         """Attach request handler
 
         No extra arguments added. Use bound methods and partials to have
         extra arguments.
+
+        Handlers run in order of prio and return (response, args, kargs).
+        A FinalResponse response ends the request with its response.
         """
 
         def fst(a):
@@ -223,3 +432,13 @@ def fst(a):
 
         self.request_handlers[name].append((prio, handler))
         self.request_handlers[name].sort(key=fst)
+
+    def request_budget(self, name, budget, default=''):
+        """Limit the time the handlers of a request may take
+
+        Once the handlers have taken longer than budget seconds, the rest
+        of them are skipped and default is sent as the reply. An answer
+        which is already complete is sent however late it is.
+        """
+
+        self.request_budgets[name] = (budget, default)
@@ -1,7 +1,8 @@
+import asyncio
 import logging
-import asyncore
+from collections import defaultdict
 from uzbl.net import Listener, Protocol
-from uzbl.core import Uzbl
+from uzbl.core import Timing, Uzbl, profile_report
 
 logger = logging.getLogger('daemon')
 
@@ -28,7 +29,7 @@ def load(self):
 
 class UzblEventDaemon(object):
     def __init__(self, plugind, config, server_socket, auto_close=False,
-                 print_events=False):
+                 print_events=False, profile=False):
         self.server_socket = server_socket
         self.auto_close = auto_close
         self.print_events = print_events
@@ -37,12 +38,24 @@ def __init__(self, plugind, config, server_socket, auto_close=False,
         self._plugin_instances = []
         self._quit = False
 
+        # epoll based on Linux, so idle instances cost nothing per wakeup.
+        self.loop = asyncio.new_event_loop()
+        asyncio.set_event_loop(self.loop)
+
         # Hold uzbl instances
         # {child socket: Uzbl instance, ..}
         self.uzbls = {}
 
         self.plugins = {}
 
+        # Handlers of state published by other worker processes
+        # {topic: [handler, ..], ..}
+        self.subscribers = defaultdict(list)
+
+        # Timings of the event and request handlers of all instances
+        # {(event name, handler name): Timing, ..}
+        self.profile = defaultdict(Timing) if profile else None
+
         # Scan plugin directory for plugins
         self.plugind.load()
 
@@ -60,7 +73,7 @@ def init_plugins(self):
 
     def listen(self):
         '''Start listening on socket'''
-        self.listener = Listener(self.server_socket)
+        self.listener = Listener(self.server_socket, loop=self.loop)
         self.listener.target = self
         self.listener.start()
 
@@ -69,17 +82,30 @@ def run(self):
 
         logger.debug('entering main loop')
 
-        asyncore.loop()
+        if not self._quit:
+            self.loop.run_forever()
 
         # Clean up and exit
         self.quit()
 
+        # Let the connections notice they have been closed.
+        tasks = [t for t in asyncio.all_tasks(self.loop) if not t.done()]
+        for task in tasks:
+            task.cancel()
+        if tasks:
+            self.loop.run_until_complete(
+                asyncio.gather(*tasks, return_exceptions=True))
+        self.loop.close()
+
         logger.debug('exiting main loop')
 
-    def add_instance(self, sock):
-        proto = Protocol(sock)
-        uzbl = Uzbl(self, proto, self.print_events)
-        self.uzbls[sock] = uzbl
+    def add_signal_handler(self, sig, handler, *args):
+        '''Run handler from the main loop when sig arrives.'''
+        self.loop.add_signal_handler(sig, handler, *args)
+
+    def add_instance(self, proto):
+        uzbl = Uzbl(self, proto, self.print_events, self.profile)
+        self.uzbls[proto.socket] = uzbl
         for plugin in self.plugins.values():
             plugin.new_uzbl(uzbl)
 
@@ -99,6 +125,24 @@ def close_server_socket(self):
         except:
             logger.error('failed to close server socket', exc_info=True)
 
+    def publish(self, topic, *args):
+        '''Share a change of global state with the other worker processes.
+        Does nothing unless instances are spread over workers (see
+        uzbl.workers), as all instances then see the same state.'''
+        pass
+
+    def subscribe(self, topic, handler):
+        '''Call handler with the arguments of whatever other worker
+        processes publish on topic.'''
+        self.subscribers[topic].append(handler)
+
+    def deliver(self, topic, args):
+        for handler in self.subscribers.get(topic, ()):
+            try:
+                handler(*args)
+            except BaseException:
+                logger.error('error in handler for %r', topic, exc_info=True)
+
     def get_plugin_config(self, name):
         if name not in self.config:
             self.config.add_section(name)
@@ -122,6 +166,12 @@ def quit(self, sigint=None, *args):
             del self.plugins  # to avoid cyclic links
             del self._plugin_instances
 
+        if not self._quit and self.profile:
+            for row in profile_report(self.profile):
+                logger.warning('%(count)8d calls %(total)10.4fs total '
+                               '%(max)8.4fs max %(event)s %(handler)s', row)
+
         if not self._quit:
             logger.info('event manager shut down')
             self._quit = True
+            self.loop.stop()
@@ -40,12 +40,12 @@
 from glob import glob
 from itertools import count
 from argparse import ArgumentParser
-from select import select
-from signal import signal, SIGTERM, SIGINT, SIGKILL
+from signal import SIGTERM, SIGINT, SIGKILL
 from traceback import format_exc
 
 from uzbl.core import Uzbl
 from uzbl.daemon import UzblEventDaemon, PluginDirectory
+from uzbl.workers import WorkerPool
 
 
 def xdghome(key, default):
@@ -271,10 +271,19 @@ def start_action(opts, config):
         del_pid_file(pid_file)
 
     plugind = PluginDirectory()
-    daemon = UzblEventDaemon(plugind, config,
-                             opts.server_socket,
-                             opts.auto_close,
-                             opts.print_events)
+    if opts.workers:
+        daemon = WorkerPool(plugind, config,
+                            opts.server_socket,
+                            opts.workers,
+                            opts.auto_close,
+                            opts.print_events,
+                            opts.profile)
+    else:
+        daemon = UzblEventDaemon(plugind, config,
+                                 opts.server_socket,
+                                 opts.auto_close,
+                                 opts.print_events,
+                                 opts.profile)
 
     daemon.listen()
 
@@ -296,7 +305,7 @@ def exit():
         daemon.quit()
 
     for sigint in [SIGTERM, SIGINT]:
-        signal(sigint, daemon.quit)
+        daemon.add_signal_handler(sigint, daemon.quit, sigint)
     atexit.register(daemon.quit)
 
     make_pid_file(opts.pid_file)
@@ -365,6 +374,10 @@ def make_parser():
         dest='auto_close', action='store_true', default=False,
         help='auto close after all instances disconnect')
 
+    add('-w', '--workers',
+        dest='workers', metavar='N', type=int, default=0,
+        help='spread instances over N worker processes')
+
     add('-o', '--log-file',
         dest='log_file', metavar='FILE',
         help='write logging output to a file, defaults to server socket +'
@@ -374,6 +387,10 @@ def make_parser():
         dest='print_events', action="store_false", default=True,
         help="silence the printing of events to stdout")
 
+    add('-P', '--profile',
+        dest='profile', action='store_true', default=False,
+        help='time the plugin handlers, see the EM_STATS request')
+
     return parser
 
 
@@ -445,7 +462,7 @@ def main():
     logger.info('daemon action %r', args.action)
     ret = daemon_actions[args.action](args, config)
 
-    logger.debug('process CPU time: %f', time.clock())
+    logger.debug('process CPU time: %f', time.process_time())
 
     return ret
 
@@ -42,6 +42,12 @@ class BasePlugin(object):
 class PerInstancePlugin(BasePlugin):
     """Base class for plugins which instantiate once per uzbl instance"""
 
+    # The events and requests the plugin connects handlers to. The plugin
+    # is created when the first of them arrives (or when another plugin
+    # looks it up); with EVENTS None it is created on INSTANCE_START.
+    EVENTS = None
+    REQUESTS = ()
+
     def __init__(self, uzbl):
         self.uzbl = uzbl
         self.plugin_config = uzbl.parent.get_plugin_config(self.CONFIG_SECTION)
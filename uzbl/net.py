@@ -1,14 +1,21 @@
 # Network communication classes
 # vi: set et ts=4:
-import asyncore
-import asynchat
-import six
+import asyncio
+import collections
+import json
 import socket
 import os
 import logging
 
 logger = logging.getLogger('uzbl.net')
 
+# Longest line accepted from an instance (cookies and bindings can get long).
+READ_LIMIT = 1 << 20
+
+# How much is read from an instance at once. A flood of events is framed
+# and decoded a chunk at a time instead of line by line.
+READ_SIZE = 1 << 16
+
 
 class NoTargetSet(Exception):
     pass
@@ -40,77 +47,217 @@ def target(self, value):
         self._target = value
 
 
-class Listener(asyncore.dispatcher, WithTarget):
+def knock(addr):
+    '''Unlink existing socket if it's stale'''
+
+    if os.path.exists(addr):
+        logger.info('socket already exists, checking if active')
+        s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        try:
+            s.connect(addr)
+        except socket.error as e:
+            logger.info('unlinking %r', addr)
+            os.unlink(addr)
+        finally:
+            s.close()
+
+
+class Listener(WithTarget):
     ''' Waits for new connections and accept()s them '''
 
-    def __init__(self, addr, target=None):
-        asyncore.dispatcher.__init__(self)
+    def __init__(self, addr, target=None, loop=None):
         self.addr = addr
         self.target = target
+        self.loop = loop or asyncio.get_event_loop()
+        self.server = None
 
     def start(self):
-        self.create_socket(socket.AF_UNIX, socket.SOCK_STREAM)
         self.knock()
-        self.set_reuse_addr()
-        self.bind(self.addr)
-        self.listen(5)
+        self.server = self.loop.run_until_complete(
+            asyncio.start_unix_server(self.handle_accept, path=self.addr,
+                                      limit=READ_LIMIT))
 
     def knock(self):
-        '''Unlink existing socket if it's stale'''
+        knock(self.addr)
 
-        if os.path.exists(self.addr):
-            logger.info('socket already exists, checking if active')
-            s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
-            try:
-                s.connect(self.addr)
-            except socket.error as e:
-                logger.info('unlinking %r', self.addr)
-                os.unlink(self.addr)
-
-    def writable(self):
-        return False
-
-    def handle_accept(self):
-        try:
-            sock, addr = self.accept()
-        except socket.error:
-            return
-        else:
-            self.target.add_instance(sock)
+    async def handle_accept(self, reader, writer):
+        proto = Protocol(reader, writer)
+        self.target.add_instance(proto)
+        await proto.run()
 
     def close(self):
-        super(Listener, self).close()
+        if self.server is None:
+            return
+        self.server.close()
+        self.server = None
         if os.path.exists(self.addr):
             logger.info('unlinking %r', self.addr)
             os.unlink(self.addr)
 
-    def handle_error(self):
-        raise
-
 
-class Protocol(asynchat.async_chat):
+class Protocol(WithTarget):
     ''' A connection with a single client '''
 
-    def __init__(self, socket, target=None):
-        asynchat.async_chat.__init__(self, socket)
-        self.socket = socket
+    def __init__(self, reader, writer, target=None):
+        self.reader = reader
+        self.writer = writer
+        self.socket = writer.get_extra_info('socket')
         self.target = target
-        self.buffer = bytearray()
-        self.set_terminator(b'\n')
-
-    def collect_incoming_data(self, data):
-        self.buffer += data
-
-    def found_terminator(self):
-        if six.PY3:
-            val = self.buffer.decode('utf-8')
-        else:
-            val = str(self.buffer)
-        del self.buffer[:]
+
+    def push(self, data):
+        self.writer.write(data)
+
+    def close(self):
+        self.writer.close()
+
+    async def run(self):
+        '''Read until the client disconnects. A trailing line without a
+        terminator is dropped.'''
+
+        pending = b''
+        discard = False
+
+        try:
+            while True:
+                data = await self.reader.read(READ_SIZE)
+                if not data:
+                    break
+
+                end = data.rfind(b'\n')
+                if end < 0:
+                    if not discard:
+                        pending += data
+                        if len(pending) > READ_LIMIT:
+                            logger.warning("invalid message longer than %d bytes", READ_LIMIT)
+                            pending = b''
+                            discard = True
+                    continue
+
+                if discard:
+                    # Skip the rest of an overlong line.
+                    start = data.find(b'\n') + 1
+                    discard = False
+                else:
+                    start = 0
+                    if pending:
+                        data = pending + data
+                        end += len(pending)
+
+                pending = data[end + 1:]
+                if start <= end:
+                    self.dispatch(memoryview(data)[start:end])
+        except ConnectionError:
+            pass
+        finally:
+            self.close()
+
+    def dispatch(self, chunk):
+        '''Pass every line of chunk (without its last terminator) to the
+        target.'''
+
         try:
-            self.target.parse_msg(val)
+            lines = str(chunk, 'utf-8').split('\n')
+        except UnicodeDecodeError:
+            lines = []
+            for line in bytes(chunk).split(b'\n'):
+                try:
+                    lines.append(line.decode('utf-8'))
+                except UnicodeDecodeError as e:
+                    logger.warning("invalid message %s", e)
+
+        parse_msg = self.target.parse_msg
+        for line in lines:
+            try:
+                parse_msg(line)
+            except ValueError as e:
+                logger.warning("invalid message %s", e)
+
+
+class Channel(WithTarget):
+    '''
+        Messages between the daemon and one of its worker processes over a
+        SOCK_SEQPACKET socket. A message is a JSON list and may carry file
+        descriptors along.
+    '''
+
+    MAX_MESSAGE = 1 << 20
+
+    def __init__(self, sock, loop, target=None):
+        self.sock = sock
+        self.loop = loop
+        self.target = target
+        self.queue = collections.deque()
+        self.closed = False
+
+        sock.setblocking(False)
+        loop.add_reader(sock, self.handle_read)
+
+    def send(self, msg, fds=()):
+        '''Queue msg to be sent. The fds are closed once they are sent.'''
+
+        if self.closed:
+            for fd in fds:
+                os.close(fd)
+            return
+
+        self.queue.append((json.dumps(msg).encode('utf-8'), list(fds)))
+        if len(self.queue) == 1:
+            self.flush()
+
+    def flush(self):
+        while self.queue:
+            data, fds = self.queue[0]
+            try:
+                socket.send_fds(self.sock, [data], fds)
+            except BlockingIOError:
+                self.loop.add_writer(self.sock, self.flush)
+                return
+            except OSError:
+                self.handle_close()
+                return
+
+            self.queue.popleft()
+            for fd in fds:
+                os.close(fd)
+
+        self.loop.remove_writer(self.sock)
+
+    def handle_read(self):
+        try:
+            data, fds, flags, addr = socket.recv_fds(self.sock, self.MAX_MESSAGE, 4)
+        except BlockingIOError:
+            return
+        except OSError:
+            data, fds = b'', []
+
+        if not data:
+            self.handle_close()
+            return
+
+        try:
+            msg = json.loads(data.decode('utf-8'))
         except ValueError as e:
             logger.warning("invalid message %s", e)
+            for fd in fds:
+                os.close(fd)
+            return
 
-    def handle_error(self):
-        raise
+        self.target.handle_message(self, msg, fds)
+
+    def handle_close(self):
+        if self.closed:
+            return
+        self.close()
+        self.target.channel_closed(self)
+
+    def close(self):
+        if self.closed:
+            return
+        self.closed = True
+        self.loop.remove_reader(self.sock)
+        self.loop.remove_writer(self.sock)
+        self.sock.close()
+        for data, fds in self.queue:
+            for fd in fds:
+                os.close(fd)
+        self.queue.clear()
@@ -19,7 +19,7 @@
 from .cmd_expand import send_user_command
 from .config import Config
 from .keycmd import KeyCmd
-from collections import Callable
+from collections.abc import Callable
 
 # Commonly used regular expressions.
 MOD_START = re.compile('^<([A-Z][A-Za-z0-9-_]*)>').match
@@ -54,6 +54,11 @@ def __init__(self, uzbl):
         # activiated binds for use in the stack mode.
         self.globals = []
 
+        # The unstacked binds of each mode sorted by the key event they
+        # handle, rebuilt after every bind change.
+        # {mode: {(mod_cmd, on_exec): [(bind, bind[0]), ..], ..}, ..}
+        self.candidates = {}
+
     def __getitem__(self, key):
         return self.get_binds(key)
 
@@ -128,9 +133,35 @@ def get_binds(self, mode=None):
         binds = dict(list(globals.items()) + list(self.binds[mode].items()))
         return [_f for _f in list(binds.values()) if _f]
 
+    def get_candidates(self, mod_cmd, on_exec):
+        '''Return the binds which could match a key event in the current
+        mode, in the order get_binds returns them, each paired with its
+        bind info at the current depth.'''
+
+        depth = self.depth
+        if depth:
+            binds = [(bind, bind[depth]) for bind in self.get_binds()]
+            return [(bind, t) for (bind, t) in binds
+                    if bool(t[MOD_CMD]) == mod_cmd and t[ON_EXEC] == on_exec]
+
+        mode = self.uzbl_config.get('mode', None) or 'global'
+        try:
+            kinds = self.candidates[mode]
+        except KeyError:
+            kinds = self.candidates[mode] = {
+                (False, False): [], (False, True): [],
+                (True, False): [], (True, True): []}
+            for bind in self.get_binds(mode):
+                t = bind[0]
+                kinds[(bool(t[MOD_CMD]), t[ON_EXEC])].append((bind, t))
+
+        return kinds[(mod_cmd, on_exec)]
+
     def add_bind(self, mode, glob, bind=None):
         '''Insert (or override) a bind into the mode bind dict.'''
 
+        self.candidates.clear()
+
         if mode not in self.binds:
             self.binds[mode] = {glob: bind}
             return
@@ -270,6 +301,8 @@ def __repr__(self):
 
 class BindPlugin(PerInstancePlugin):
     CONFIG_SECTION = 'bind'
+    EVENTS = ('BIND', 'MODE_BIND', 'MODE_CHANGED', 'KEYCMD_UPDATE',
+              'KEYCMD_EXEC', 'MODCMD_UPDATE', 'MODCMD_EXEC')
 
     def __init__(self, uzbl):
         '''Export functions and connect handlers to events.'''
@@ -439,9 +472,10 @@ def match_and_exec(self, bind, depth, modstate, keylet, bindlet):
     def key_event(self, modstate, keylet, mod_cmd=False, on_exec=False):
         bindlet = self.bindlet
         depth = bindlet.depth
-        for bind in bindlet.get_binds():
-            t = bind[depth]
-            if (bool(t[MOD_CMD]) != mod_cmd) or (t[ON_EXEC] != on_exec):
+        cmd = keylet.modcmd if mod_cmd else keylet.keycmd
+        for (bind, t) in bindlet.get_candidates(mod_cmd, on_exec):
+            # Cheap rejection of most binds before the full match below.
+            if not cmd.startswith(t[GLOB]):
                 continue
 
             if self.match_and_exec(bind, depth, modstate, keylet, bindlet):
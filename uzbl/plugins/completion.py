@@ -49,6 +49,8 @@ def format(self, partial, completions):
 
 class CompletionPlugin(PerInstancePlugin):
     CONFIG_SECTION = 'completion'
+    EVENTS = ('BUILTINS', 'CONFIG_CHANGED', 'KEYCMD_CLEARED', 'KEYCMD_EXEC',
+              'KEYCMD_UPDATE', 'START_COMPLETION', 'STOP_COMPLETION')
 
     def __init__(self, uzbl):
         '''Export functions and connect handlers to events.'''
@@ -16,6 +16,7 @@ class Config(PerInstancePlugin):
     """
 
     CONFIG_SECTION = 'config'
+    EVENTS = ('VARIABLE_SET',)
 
     def __init__(self, uzbl):
         super(Config, self).__init__(uzbl)
@@ -2,10 +2,13 @@
     forwards cookies to all other instances connected to the event manager"""
 
 from __future__ import print_function
-from collections import defaultdict
+from collections import defaultdict, OrderedDict
+from contextlib import contextmanager
+import fcntl
 import os
 import re
 import stat
+import tempfile
 
 from uzbl.arguments import splitquoted
 from uzbl.ext import GlobalPlugin, PerInstancePlugin
@@ -32,18 +35,14 @@ def match(key, cookie):
     return True
 
 
-def match_list(_list, cookie):
-    for matcher in _list:
-        for component, match in matcher:
-            if match(cookie[component]) is None:
-                break
-        else:
-            return True
-    return False
+# domain rules which only compare a literal against the end of the domain,
+# optionally anchored at its start or at a label boundary
+literal_domain_rule = re.compile(
+    r'^(\^|\((?:\?:)?\^\|\\\.\))?((?:[A-Za-z0-9_-]|\\\.)+)\$$').match
 
 
-def add_cookie_matcher(_list, arg):
-    ''' add a cookie matcher to a whitelist or a blacklist.
+def parse_cookie_matcher(arg):
+    ''' parse a cookie matcher for a whitelist or a blacklist.
         a matcher is a list of (component, re) tuples that matches a cookie
         when the "component" part of the cookie matches the regular expression
         "re". "component" is one of the keys defined in the variable
@@ -58,8 +57,113 @@ def add_cookie_matcher(_list, arg):
         except KeyError:
             component = int(component)
         assert component <= 5
-        mlist.append((component, re.compile(regexp).search))
-    _list.append(mlist)
+        re.compile(regexp)
+        mlist.append((component, regexp))
+    return mlist
+
+
+class CookieMatcher(object):
+    r''' a list of cookie matchers compiled into a single decision.
+
+        domain rules which are plain suffixes (e.g. "example\.com$") are
+        looked up by the suffixes of the cookie's domain, the other single
+        component rules are merged into one alternation per component and
+        only rules on several components are tried one by one. results are
+        remembered per value of the components the rules look at.
+    '''
+
+    MEMO_SIZE = 4096
+
+    def __init__(self):
+        self.rules = []
+        self.compiled = None
+
+    def __len__(self):
+        return len(self.rules)
+
+    def add(self, arg):
+        self.rules.append(parse_cookie_matcher(arg))
+        self.compiled = None
+
+    def match(self, cookie):
+        if self.compiled is None:
+            self.compile()
+        suffixes, exact, merged, multi, components, memo = self.compiled
+
+        key = tuple(cookie[c] for c in components)
+        try:
+            return memo[key]
+        except KeyError:
+            pass
+
+        result = self.evaluate(cookie)
+        if len(memo) >= self.MEMO_SIZE:
+            memo.clear()
+        memo[key] = result
+        return result
+
+    def evaluate(self, cookie):
+        suffixes, exact, merged, multi, components, memo = self.compiled
+
+        domain = cookie[symbolic['domain']]
+        if domain in exact:
+            return True
+        if suffixes:
+            for i in range(len(domain)):
+                if domain[i:] in suffixes:
+                    return True
+
+        for component, search in merged:
+            if search(cookie[component]) is not None:
+                return True
+
+        for matcher in multi:
+            for component, search in matcher:
+                if search(cookie[component]) is None:
+                    break
+            else:
+                return True
+
+        return False
+
+    def compile(self):
+        suffixes, exact = set(), set()
+        single = defaultdict(list)
+        multi = []
+        components = set()
+
+        for matcher in self.rules:
+            components.update(c for c, r in matcher)
+            if len(matcher) == 1:
+                component, regexp = matcher[0]
+                literal = literal_domain_rule(regexp)
+                if component == symbolic['domain'] and literal:
+                    anchor, name = literal.groups()
+                    name = name.replace('\\.', '.')
+                    if anchor == '^':
+                        exact.add(name)
+                    elif anchor:
+                        exact.add(name)
+                        suffixes.add('.' + name)
+                    else:
+                        suffixes.add(name)
+                    continue
+                single[component].append(regexp)
+            else:
+                multi.append([(c, re.compile(r).search) for c, r in matcher])
+
+        merged = []
+        for component, regexps in single.items():
+            try:
+                search = re.compile('|'.join('(?:%s)' % r for r in regexps)).search
+                merged.append((component, search))
+            except re.error:
+                # e.g. group names clash; keep the rules apart
+                multi.extend([(component, re.compile(r).search)]
+                             for r in regexps)
+
+        self.compiled = (suffixes, exact, merged, multi,
+                         sorted(components), {})
 
 
 class NullStore(object):
@@ -72,6 +176,9 @@ def add_cookie(self, rawcookie, cookie):
     def delete_cookie(self, rkey, key):
         pass
 
+    def close(self):
+        pass
+
 
 class ListStore(list):
     def __init__(self, filename):
@@ -83,8 +190,29 @@ def add_cookie(self, rawcookie, cookie):
     def delete_cookie(self, rkey, key):
         self[:] = [x for x in self if not match(key, splitquoted(x))]
 
+    def close(self):
+        pass
+
 
 class TextStore(object):
+    """cookies.txt store
+
+    The file is only appended to: a replaced cookie is superseded by a later
+    line and a deleted one by an expired copy of it (which libsoup treats as a
+    deletion when the file is loaded in order). An in-memory index keyed by
+    (domain, path, name) tracks the live cookies and the file is rewritten
+    from it once superseded lines outnumber them.
+
+    Several processes (event manager workers) may share the file. Changes
+    are made holding a lock on a file next to it, and the index only reads
+    what others appended since it was last brought up to date unless the file
+    was replaced."""
+
+    # expiry of the lines recording deletions
+    TOMBSTONE = '1'
+    # never compact files with fewer superseded lines than this
+    COMPACT_THRESHOLD = 1000
+
     def __init__(self, filename):
         self.filename = filename
         try:
@@ -97,6 +225,12 @@ def __init__(self, filename):
         except OSError:
             pass
 
+        # the file the index was read from and how far
+        self.file = None
+        self.index = None
+        self.lines = 0
+        self.offset = 0
+
     def as_event(self, cookie):
         """Convert cookie.txt row to uzbls cookie event format"""
         scheme = {
@@ -148,38 +282,141 @@ def as_file(self, cookie):
     def add_cookie(self, rawcookie, cookie):
         assert len(cookie) == 6
 
-        # delete equal cookies (ignoring expire time, value and secure flag)
-        self.delete_cookie(None, cookie[:-3])
+        with self.locked():
+            self.update()
 
-        # restrict umask before creating the cookie jar
-        curmask = os.umask(0)
-        os.umask(curmask | stat.S_IRWXO | stat.S_IRWXG)
+            # replace equal cookies (ignoring expire time, value and secure
+            # flag)
+            key = tuple(cookie[:3])
+            row = self.as_file(cookie)
+            self.index.pop(key, None)
+            self.index[key] = row
 
-        first = not os.path.exists(self.filename)
-        with open(self.filename, 'a') as f:
-            if first:
-                print("# HTTP Cookie File", file=f)
-            print('\t'.join(self.as_file(cookie)), file=f)
+            self.append([row])
 
     def delete_cookie(self, rkey, key):
-        if not os.path.exists(self.filename):
+        with self.locked():
+            self.update()
+
+            if len(key) >= 3:
+                keys = [tuple(key[:3])] if tuple(key[:3]) in self.index else []
+            else:
+                keys = list(self.index)
+
+            tombstones = []
+            for k in keys:
+                row = self.index[k]
+                if match(key, self.as_event(row)):
+                    del self.index[k]
+                    tombstones.append(row[:4] + (self.TOMBSTONE,) + row[5:])
+
+            if tombstones:
+                self.append(tombstones)
+
+    @contextmanager
+    def locked(self):
+        """Hold the lock shared by every process writing the file"""
+        fd = os.open(self.filename + '.lock', os.O_RDWR | os.O_CREAT, 0o600)
+        try:
+            fcntl.lockf(fd, fcntl.LOCK_EX)
+            yield
+        finally:
+            # closing the descriptor releases the lock
+            os.close(fd)
+
+    def load(self):
+        """Bring the index up to date with the file"""
+        with self.locked():
+            self.update()
+
+    def update(self):
+        try:
+            st = os.stat(self.filename)
+        except OSError:
+            self.reset(None)
+            return
+
+        # the open file keeps its inode from being reused by a replacement
+        if (self.file is None or st.st_size < self.offset or
+                not os.path.samestat(st, os.fstat(self.file.fileno()))):
+            self.reset(self.open())
+        if st.st_size == self.offset:
             return
 
-        # restrict umask before creating the cookie jar
-        curmask = os.umask(0)
-        os.umask(curmask | stat.S_IRWXO | stat.S_IRWXG)
+        self.file.seek(self.offset)
+        data = self.file.read()
+
+        # leave an unfinished last line for next time
+        data = data[:data.rfind(b'\n') + 1]
+        self.offset += len(data)
+
+        for l in data.decode('utf-8', 'surrogateescape').splitlines():
+            row = tuple(l.split('\t'))
+            c = self.as_event(row)
+            if c is None:
+                continue
+            self.lines += 1
+
+            key = c[:3]
+            self.index.pop(key, None)
+            if c[5] != self.TOMBSTONE:
+                self.index[key] = row
+
+    def open(self):
+        # the cookie jar is created private
+        fd = os.open(self.filename, os.O_RDWR | os.O_APPEND | os.O_CREAT, 0o600)
+        return os.fdopen(fd, 'a+b')
+
+    def reset(self, file):
+        if self.file is not None:
+            self.file.close()
+        self.file = file
+        self.index = OrderedDict()
+        self.lines = 0
+        self.offset = 0
+
+    def close(self):
+        """Release the file; the next access opens and reads it afresh"""
+        self.reset(None)
+
+    def encode(self, rows):
+        return ''.join('\t'.join(row) + '\n' for row in rows).encode(
+            'utf-8', 'surrogateescape')
+
+    def append(self, rows):
+        if self.file is None:
+            self.file = self.open()
+        if not self.offset:
+            self.file.write(b'# HTTP Cookie File\n')
+        self.file.write(self.encode(rows))
+        self.file.flush()
+
+        # the index was up to date, so only these rows are new
+        self.lines += len(rows)
+        self.offset = os.fstat(self.file.fileno()).st_size
+
+        superseded = self.lines - len(self.index)
+        if superseded > max(self.COMPACT_THRESHOLD, len(self.index)):
+            self.compact()
+
+    def compact(self):
+        """Rewrite the file with only the live cookies"""
+        dirname, basename = os.path.split(self.filename)
+        fd, tmpname = tempfile.mkstemp(prefix=basename + '.', dir=dirname or '.')
 
-        # read all cookies
-        with open(self.filename, 'r') as f:
-            cookies = f.readlines()
+        try:
+            with os.fdopen(fd, 'wb') as f:
+                f.write(b'# HTTP Cookie File\n')
+                f.write(self.encode(self.index.values()))
+            os.replace(tmpname, self.filename)
+        except BaseException:
+            os.unlink(tmpname)
+            raise
 
-        # write those that don't match the cookie to delete
-        with open(self.filename, 'w') as f:
-            for l in cookies:
-                c = self.as_event(l.split('\t'))
-                if c is None or not match(key, c):
-                    print(l, end='', file=f)
-        os.umask(curmask)
+        self.file.close()
+        self.file = self.open()
+        self.lines = len(self.index)
+        self.offset = os.fstat(self.file.fileno()).st_size
 
 
 DEFAULT_STORE = None
@@ -192,15 +429,41 @@ def delete_cookie(self, rkey, key):
 }
 
 
+def get_config(uzbl, key, default):
+    try:
+        config = Config[uzbl]
+    except KeyError:
+        return default
+
+    return config.get(key, default)
+
+
+def is_private(uzbl):
+    return get_config(uzbl, 'enable_private', 0) == 1
+
+
+def recipients(uzbls, shared):
+    """ instances which should hear about a cookie change made by an
+    instance using the cookie file shared """
+
+    # instances sharing a cookie file already see each other's cookies
+    def is_shared(uzbl):
+        return shared and get_config(uzbl, 'shared_cookie_file', '') == shared
+
+    return [u for u in uzbls if not is_private(u) and not is_shared(u)]
+
+
 class Cookies(PerInstancePlugin):
     CONFIG_SECTION = 'cookies'
+    EVENTS = ('ADD_COOKIE', 'DELETE_COOKIE', 'BLACKLIST_COOKIE',
+              'WHITELIST_COOKIE', 'SECURE_COOKIE', 'CLEAR_SECURE_COOKIE_RULES')
 
     def __init__(self, uzbl):
         super(Cookies, self).__init__(uzbl)
 
-        self.secure = []
-        self.whitelist = []
-        self.blacklist = []
+        self.secure = CookieMatcher()
+        self.whitelist = CookieMatcher()
+        self.blacklist = CookieMatcher()
 
         uzbl.connect('ADD_COOKIE', self.add_cookie)
         uzbl.connect('DELETE_COOKIE', self.delete_cookie)
@@ -216,11 +479,11 @@ def __init__(self, uzbl):
     # b. the cookie is in the whitelist and not in the blacklist
     def accept_cookie(self, cookie):
         if self.whitelist:
-            if match_list(self.whitelist, cookie):
-                return not match_list(self.blacklist, cookie)
+            if self.whitelist.match(cookie):
+                return not self.blacklist.match(cookie)
             return False
 
-        return not match_list(self.blacklist, cookie)
+        return not self.blacklist.match(cookie)
 
     def expires_with_session(self, cookie):
         return cookie[5] == ''
@@ -228,19 +491,23 @@ def expires_with_session(self, cookie):
     def get_recipents(self):
         """ get a list of Uzbl instances to send the cookie too. """
 
-        def is_private(uzbl):
-            try:
-                config = Config[uzbl]
-            except KeyError:
-                return False
-
-            return config.get('enable_private', 0) == 1
-
         if is_private(self.uzbl):
             return []
 
+        shared = get_config(self.uzbl, 'shared_cookie_file', '')
         uzbls = self.uzbl.parent.uzbls.values()
-        return [u for u in uzbls if u is not self.uzbl and not is_private(u)]
+        return [u for u in recipients(uzbls, shared) if u is not self.uzbl]
+
+    def share(self, action, cookie):
+        """ send a cookie change to the other instances, including those
+        served by other worker processes """
+
+        for u in self.get_recipents():
+            u.send('cookie %s %s' % (action, cookie.safe_raw()))
+
+        if not is_private(self.uzbl):
+            shared = get_config(self.uzbl, 'shared_cookie_file', '')
+            self.uzbl.parent.publish('cookie', action, cookie.safe_raw(), shared)
 
     def _make_store(self, cookie_type, envvar, fname):
         store_type = self.plugin_config.get('%s.type' % cookie_type, 'text')
@@ -279,7 +546,7 @@ def add_cookie(self, cookie):
         cookie = splitquoted(cookie)
 
         if self.secure:
-            if match_list(self.secure, cookie):
+            if self.secure.match(cookie):
                 make_secure = {
                     'http': 'https',
                     'httpOnly': 'httpsOnly'
@@ -295,8 +562,7 @@ def add_cookie(self, cookie):
                     return
 
         if self.accept_cookie(cookie):
-            for u in self.get_recipents():
-                u.send('cookie add %s' % cookie.safe_raw())
+            self.share('add', cookie)
 
             store = self.get_store(self.expires_with_session(cookie))
             store.add_cookie(cookie.raw(), cookie)
@@ -306,8 +572,7 @@ def add_cookie(self, cookie):
 
     def delete_cookie(self, cookie):
         cookie = splitquoted(cookie)
-        for u in self.get_recipents():
-            u.send('cookie delete %s' % cookie.safe_raw())
+        self.share('delete', cookie)
 
         if len(cookie) == 6:
             store = self.get_store(self.expires_with_session(cookie))
@@ -318,13 +583,36 @@ def delete_cookie(self, cookie):
                 store.delete_cookie(cookie.raw(), cookie)
 
     def blacklist_cookie(self, arg):
-        add_cookie_matcher(self.blacklist, arg)
+        self.blacklist.add(arg)
 
     def whitelist_cookie(self, arg):
-        add_cookie_matcher(self.whitelist, arg)
+        self.whitelist.add(arg)
 
     def secure_cookie(self, arg):
-        add_cookie_matcher(self.secure, arg)
+        self.secure.add(arg)
 
     def clear_secure_cookies(self, arg):
-        self.secure = []
+        self.secure = CookieMatcher()
+
+    def cleanup(self):
+        # the stores are shared, so they only let go of their files here and
+        # reopen them for whichever instance uses them next
+        for store in (DEFAULT_STORE, SESSION_STORE):
+            if store is not None:
+                store.close()
+        super(Cookies, self).cleanup()
+
+
+class CookieSync(GlobalPlugin):
+    """ passes on cookie changes from instances served by other worker
+    processes """
+
+    CONFIG_SECTION = 'cookies'
+
+    def __init__(self, event_manager):
+        super(CookieSync, self).__init__(event_manager)
+        event_manager.subscribe('cookie', self.cookie_changed)
+
+    def cookie_changed(self, action, cookie, shared):
+        for u in recipients(self.event_manager.uzbls.values(), shared):
+            u.send('cookie %s %s' % (action, cookie))
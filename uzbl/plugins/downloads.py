@@ -13,6 +13,7 @@
 
 class Downloads(PerInstancePlugin):
     CONFIG_SECTION = 'downloads'
+    EVENTS = ('DOWNLOAD_STARTED', 'DOWNLOAD_PROGRESS', 'DOWNLOAD_COMPLETE')
 
     def __init__(self, uzbl):
         super(Downloads, self).__init__(uzbl)
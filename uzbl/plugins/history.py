@@ -11,6 +11,7 @@ class SharedHistory(GlobalPlugin):
     def __init__(self, event_manager):
         super(SharedHistory, self).__init__(event_manager)
         self.history = {}  #TODO(tailhook) save and load from file
+        event_manager.subscribe('history', self.store)
 
     def get_line_number(self, prompt):
         try:
@@ -19,6 +20,10 @@ def get_line_number(self, prompt):
             return 0
 
     def addline(self, prompt, entry):
+        self.store(prompt, entry)
+        self.event_manager.publish('history', prompt, entry)
+
+    def store(self, prompt, entry):
         lst = self.history.get(prompt)
         if lst is None:
             self.history[prompt] = [entry]
@@ -35,11 +40,13 @@ def getline(self, prompt, index):
 
 class History(PerInstancePlugin):
     CONFIG_SECTION = 'history'
+    EVENTS = ('KEYCMD_EXEC', 'HISTORY_PREV', 'HISTORY_NEXT', 'HISTORY_SEARCH')
 
     def __init__(self, uzbl):
         super(History, self).__init__(uzbl)
         self._tail = ''
-        self.prompt = ''
+        # The prompt may have been set before the plugin was created.
+        self.prompt = Config[uzbl].get('keycmd_prompt', '')
         self.cursor = None
         self.search_key = None
         uzbl.connect('KEYCMD_EXEC', self.keycmd_exec)
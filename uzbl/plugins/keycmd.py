@@ -226,6 +226,11 @@ def __repr__(self):
 
 class KeyCmd(PerInstancePlugin):
     CONFIG_SECTION = 'keycmd'
+    EVENTS = ('APPEND_KEYCMD', 'IGNORE_KEY', 'INJECT_KEYCMD', 'KEYCMD_BACKSPACE',
+              'KEYCMD_DELETE', 'KEYCMD_EXEC_CURRENT', 'KEYCMD_STRIP_WORD',
+              'KEYCMD_CLEAR', 'KEY_PRESS', 'KEY_RELEASE', 'MOD_PRESS',
+              'MOD_RELEASE', 'MODMAP', 'SET_CURSOR_POS', 'SET_KEYCMD',
+              'FOCUS_LOST')
 
     def __init__(self, uzbl):
         '''Export functions and connect handlers to events.'''
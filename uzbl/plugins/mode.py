@@ -8,6 +8,8 @@
 
 class ModePlugin(PerInstancePlugin):
     CONFIG_SECTION = 'mode'
+    # CONFIG_CHANGED reaches the plugin through its on_set handlers.
+    EVENTS = ('MODE_CONFIG', 'MODE_CONFIRM', 'CONFIG_CHANGED')
 
     def __init__(self, uzbl):
         super(ModePlugin, self).__init__(uzbl)
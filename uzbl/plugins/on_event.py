@@ -36,6 +36,7 @@ def match_args(pattern, args):
 
 class OnEventPlugin(PerInstancePlugin):
     CONFIG_SECTION = 'on_event'
+    EVENTS = ('ON_EVENT',)
 
     def __init__(self, uzbl):
         '''Export functions and connect handlers to events.'''
@@ -5,7 +5,7 @@
 from .cmd_expand import cmd_expand
 from uzbl.arguments import splitquoted
 from uzbl.ext import PerInstancePlugin
-import collections
+from collections.abc import Callable
 
 valid_glob = compile('^[A-Za-z0-9_\*\.]+$').match
 
@@ -18,6 +18,7 @@ def make_matcher(glob):
 
 class OnSetPlugin(PerInstancePlugin):
     CONFIG_SECTION = 'on_set'
+    EVENTS = ('ON_SET', 'CONFIG_CHANGED')
 
     def __init__(self, uzbl):
         super(OnSetPlugin, self).__init__(uzbl)
@@ -29,7 +30,7 @@ def _exec_handlers(self, handlers, key, arg):
         '''Execute the on_set handlers that matched the key.'''
 
         for handler in handlers:
-            if isinstance(handler, collections.Callable):
+            if isinstance(handler, Callable):
                 handler(key, arg)
             else:
                 self.uzbl.send(cmd_expand(handler, [key, arg]))
@@ -53,7 +54,7 @@ def on_set(self, glob, handler, prepend=True):
         while '**' in glob:
             glob = glob.replace('**', '*')
 
-        if isinstance(handler, collections.Callable):
+        if isinstance(handler, Callable):
             orig_handler = handler
             if prepend:
                 handler = partial(handler, self.uzbl)
@@ -5,6 +5,7 @@
 
 class ProgressBar(PerInstancePlugin):
     CONFIG_SECTION = 'progress'
+    EVENTS = ('LOAD_COMMIT', 'LOAD_PROGRESS')
 
     splitfrmt = re.compile(r'(%[A-Z][^%]|%[^%])').split
 
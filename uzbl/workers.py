@@ -0,0 +1,238 @@
+'''
+Spreads uzbl instances over a number of worker processes, so that a busy
+instance only holds up the instances sharing its worker, and all cores are
+used.
+
+The WorkerPool accepts the connections and hands each one (the socket
+itself) to the worker with the fewest instances. A worker is a
+WorkerDaemon, which runs the plugins for its instances like a single
+UzblEventDaemon would. Global plugins exist once per worker and keep their
+state in step through UzblEventDaemon.publish, which the pool passes on to
+every other worker.
+'''
+
+import asyncio
+import logging
+import os
+import signal
+import socket
+from multiprocessing import Process
+
+from uzbl.net import Channel, Protocol, READ_LIMIT, knock
+from uzbl.daemon import UzblEventDaemon
+
+logger = logging.getLogger('workers')
+
+
+class WorkerDaemon(UzblEventDaemon):
+    '''The event daemon of one worker process.'''
+
+    def __init__(self, sock, plugind, config, print_events=False,
+                 profile=False):
+        super(WorkerDaemon, self).__init__(plugind, config, None,
+                                           print_events=print_events,
+                                           profile=profile)
+        self.channel = Channel(sock, self.loop, self)
+
+    def publish(self, topic, *args):
+        self.channel.send(['publish', topic] + list(args))
+
+    def handle_message(self, channel, msg, fds):
+        if msg[0] == 'instance':
+            sock = socket.socket(fileno=fds[0])
+            self.loop.create_task(self.serve(sock))
+        elif msg[0] == 'publish':
+            self.deliver(msg[1], msg[2:])
+        elif msg[0] == 'quit':
+            self.quit()
+
+    def channel_closed(self, channel):
+        logger.error('lost connection to the event manager')
+        self.quit()
+
+    async def serve(self, sock):
+        reader, writer = await asyncio.open_unix_connection(
+            sock=sock, limit=READ_LIMIT)
+        proto = Protocol(reader, writer)
+        self.add_instance(proto)
+        await proto.run()
+
+    def remove_instance(self, sock):
+        if sock in self.uzbls:
+            self.channel.send(['removed'])
+        super(WorkerDaemon, self).remove_instance(sock)
+
+    def close_server_socket(self):
+        self.channel.close()
+
+
+def run_worker(sock, inherited, plugind, config, print_events, profile):
+    # Only the event manager itself listens and reacts to ^C.
+    for s in inherited:
+        s.close()
+    signal.signal(signal.SIGINT, signal.SIG_IGN)
+
+    worker = WorkerDaemon(sock, plugind, config, print_events, profile)
+    worker.add_signal_handler(signal.SIGTERM, worker.quit)
+    worker.run()
+
+
+class Worker(object):
+    def __init__(self, process, sock):
+        self.process = process
+        self.sock = sock
+        self.channel = None
+        self.instances = 0
+
+
+class WorkerPool(object):
+    '''Accepts instances and hands them out to worker processes.'''
+
+    def __init__(self, plugind, config, server_socket, workers,
+                 auto_close=False, print_events=False, profile=False):
+        self.plugind = plugind
+        self.config = config
+        self.server_socket = server_socket
+        self.count = workers
+        self.auto_close = auto_close
+        self.print_events = print_events
+        self.profile = profile
+
+        self.workers = []
+        self.instances = 0
+        self.sock = None
+        self.loop = None
+        self.signals = []
+        self._quit = False
+
+    def listen(self):
+        '''Start listening on socket'''
+        knock(self.server_socket)
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.bind(self.server_socket)
+        self.sock.listen(128)
+
+    def add_signal_handler(self, sig, handler, *args):
+        '''Run handler from the main loop when sig arrives.'''
+        self.signals.append((sig, handler, args))
+
+    def start_worker(self):
+        sock, child = socket.socketpair(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+        inherited = [self.sock, sock] + [w.sock for w in self.workers]
+        process = Process(target=run_worker,
+                          args=(child, inherited, self.plugind, self.config,
+                                self.print_events, self.profile))
+        process.start()
+        child.close()
+
+        logger.info('started worker %d', process.pid)
+        self.workers.append(Worker(process, sock))
+
+    def run(self):
+        '''Main event loop.'''
+
+        # The workers are forked before there is a loop or any signal
+        # handler which they could inherit.
+        for i in range(self.count):
+            self.start_worker()
+
+        self.loop = asyncio.new_event_loop()
+        asyncio.set_event_loop(self.loop)
+        for sig, handler, args in self.signals:
+            self.loop.add_signal_handler(sig, handler, *args)
+        for worker in self.workers:
+            worker.channel = Channel(worker.sock, self.loop, self)
+
+        self.sock.setblocking(False)
+        self.loop.add_reader(self.sock, self.handle_accept)
+
+        logger.debug('entering main loop')
+
+        if not self._quit:
+            self.loop.run_forever()
+
+        self.quit()
+
+        for worker in self.workers:
+            worker.process.join(5)
+            if worker.process.is_alive():
+                logger.error('worker %d did not exit', worker.process.pid)
+                worker.process.terminate()
+        self.loop.close()
+
+        logger.debug('exiting main loop')
+
+    def handle_accept(self):
+        try:
+            conn, addr = self.sock.accept()
+        except (BlockingIOError, InterruptedError):
+            return
+
+        if not self.workers:
+            conn.close()
+            return
+
+        worker = min(self.workers, key=lambda w: w.instances)
+        worker.instances += 1
+        self.instances += 1
+        worker.channel.send(['instance'], [conn.detach()])
+
+    def get_worker(self, channel):
+        for worker in self.workers:
+            if worker.channel is channel:
+                return worker
+
+    def handle_message(self, channel, msg, fds):
+        for fd in fds:
+            os.close(fd)
+
+        worker = self.get_worker(channel)
+        if msg[0] == 'publish':
+            for other in self.workers:
+                if other is not worker:
+                    other.channel.send(msg)
+        elif msg[0] == 'removed':
+            worker.instances -= 1
+            self.instances -= 1
+            if not self.instances and self.auto_close:
+                self.quit()
+
+    def channel_closed(self, channel):
+        worker = self.get_worker(channel)
+        if not self._quit:
+            logger.error('worker %d exited', worker.process.pid)
+        self.instances -= worker.instances
+        worker.instances = 0
+        self.workers.remove(worker)
+        worker.process.join()
+
+        if not self.workers:
+            self.quit()
+
+    def quit(self, sigint=None, *args):
+        '''Stop the workers and close the server socket.'''
+
+        if self._quit:
+            return
+        self._quit = True
+
+        logger.debug('shutting down event manager')
+
+        if self.sock is not None:
+            if self.loop is not None and not self.loop.is_closed():
+                self.loop.remove_reader(self.sock)
+            self.sock.close()
+            if os.path.exists(self.server_socket):
+                logger.info('unlinking %r', self.server_socket)
+                os.unlink(self.server_socket)
+
+        for worker in self.workers:
+            if worker.channel is not None:
+                worker.channel.send(['quit'])
+            else:
+                worker.process.terminate()
+
+        if self.loop is not None and not self.loop.is_closed():
+            self.loop.stop()
+
+        logger.info('event manager shut down')